@@ -1,17 +1,31 @@
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <bit>
 #include <cassert>
 #include <charconv>
+#include <cmath>
+#include <compare>
+#include <cstdint>
 #include <fstream>
 #include <iostream>
+#include <list>
 #include <map>
+#include <memory>
+#include <numbers>
 #include <numeric>
+#include <optional>
 #include <queue>
 #include <regex>
 #include <set>
+#include <span>
 #include <sstream>
 #include <string>
 #include <string_view>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
 
 std::string day_path(const std::string& day, const std::string& input) {
     using std::filesystem::path;
@@ -70,4 +84,914 @@ T parse_from_substr(std::string_view s,
     assert(r.ec == std::errc());
 
     return value;
-}
\ No newline at end of file
+}
+
+/// Threads for `work` items when each thread should get at least
+/// `min_per_thread` of them, but no more than the hardware runs at once.
+size_t worker_count(size_t work, size_t min_per_thread) {
+    return std::clamp<size_t>(
+        work / min_per_thread, 1,
+        std::max(1u, std::thread::hardware_concurrency()));
+}
+
+/// Runs `worker(t)` for every `t < threads`, the first on the calling
+/// thread, and waits for all of them.
+template <typename F>
+void run_workers(size_t threads, F worker) {
+    std::vector<std::thread> workers;
+    for (size_t t = 1; t < threads; ++t) {
+        workers.emplace_back(worker, t);
+    }
+    worker(0);
+    for (auto& w : workers) {
+        w.join();
+    }
+}
+
+/// Unsigned integer of arbitrary width for counts that outgrow 64 bits.
+/// Limbs hold base 2^32 digits in 64-bit words, so additions are plain
+/// element-wise sums (vectorisable) and carries are propagated lazily.
+class BigUint {
+   public:
+    BigUint(unsigned long long v = 0) {
+        while (v) {
+            limbs.push_back(v & LIMB_MASK);
+            v >>= LIMB_BITS;
+        }
+    }
+
+    BigUint& operator+=(const BigUint& other) {
+        if (terms + other.terms > MAX_TERMS) {
+            normalize();
+            if (terms + other.terms > MAX_TERMS) {
+                return *this += BigUint(other).normalize();
+            }
+        }
+
+        if (limbs.size() < other.limbs.size()) {
+            limbs.resize(other.limbs.size(), 0);
+        }
+        for (size_t i = 0; i < other.limbs.size(); ++i) {
+            limbs[i] += other.limbs[i];
+        }
+        terms += other.terms;
+
+        return *this;
+    }
+
+    friend BigUint operator+(BigUint a, const BigUint& b) { return a += b; }
+
+    /// Schoolbook product of the normalised limbs: a limb product plus two
+    /// limbs of carry still fits in 64 bits.
+    friend BigUint operator*(const BigUint& a, const BigUint& b) {
+        const auto x = BigUint(a).normalize();
+        const auto y = BigUint(b).normalize();
+
+        BigUint result;
+        if (x.limbs.empty() || y.limbs.empty()) {
+            return result;
+        }
+
+        result.limbs.assign(x.limbs.size() + y.limbs.size(), 0);
+        for (size_t i = 0; i < x.limbs.size(); ++i) {
+            uint64_t carry = 0;
+            for (size_t j = 0; j < y.limbs.size(); ++j) {
+                const uint64_t cur =
+                    x.limbs[i] * y.limbs[j] + result.limbs[i + j] + carry;
+                result.limbs[i + j] = cur & LIMB_MASK;
+                carry = cur >> LIMB_BITS;
+            }
+            result.limbs[i + y.limbs.size()] = carry;
+        }
+        result.trim();
+
+        return result;
+    }
+
+    BigUint& operator*=(const BigUint& other) { return *this = *this * other; }
+
+    friend bool operator==(const BigUint& a, const BigUint& b) {
+        return BigUint(a).normalize().limbs == BigUint(b).normalize().limbs;
+    }
+
+    std::string to_string() const {
+        BigUint a(*this);
+        a.normalize();
+        if (a.limbs.empty()) {
+            return "0";
+        }
+
+        constexpr uint64_t CHUNK = 1'000'000'000;
+        std::vector<uint64_t> chunks;
+        while (!a.limbs.empty()) {
+            uint64_t rem = 0;
+            for (size_t i = a.limbs.size(); i-- > 0;) {
+                const uint64_t cur = (rem << LIMB_BITS) | a.limbs[i];
+                a.limbs[i] = cur / CHUNK;
+                rem = cur % CHUNK;
+            }
+            a.trim();
+            chunks.push_back(rem);
+        }
+
+        std::string result = std::to_string(chunks.back());
+        for (size_t i = chunks.size() - 1; i-- > 0;) {
+            const auto part = std::to_string(chunks[i]);
+            result += std::string(9 - part.size(), '0') + part;
+        }
+
+        return result;
+    }
+
+   private:
+    static constexpr unsigned LIMB_BITS = 32;
+    static constexpr uint64_t LIMB_MASK = (uint64_t(1) << LIMB_BITS) - 1;
+    // Every limb is at most `terms * LIMB_MASK`, which must fit in 64 bits.
+    static constexpr uint64_t MAX_TERMS = uint64_t(1) << 31;
+
+    BigUint& normalize() {
+        uint64_t carry = 0;
+        for (auto& limb : limbs) {
+            const uint64_t cur = limb + carry;
+            limb = cur & LIMB_MASK;
+            carry = cur >> LIMB_BITS;
+        }
+        while (carry) {
+            limbs.push_back(carry & LIMB_MASK);
+            carry >>= LIMB_BITS;
+        }
+        trim();
+        terms = 1;
+
+        return *this;
+    }
+
+    void trim() {
+        while (!limbs.empty() && limbs.back() == 0) {
+            limbs.pop_back();
+        }
+    }
+
+    std::vector<uint64_t> limbs;
+    uint64_t terms = 1;
+};
+
+/// Signed integer of arbitrary width for exact arithmetic that outgrows
+/// `__int128`. The magnitude is kept as base 2^32 digits without leading
+/// zeros, and zero is never negative. Division truncates toward zero like
+/// the built-in types.
+class BigInt {
+   public:
+    BigInt(long long v = 0) : negative(v < 0) {
+        for (auto u = v < 0 ? 0ULL - v : (unsigned long long)v; u;
+             u >>= DIGIT_BITS) {
+            digits.push_back((uint32_t)u);
+        }
+    }
+
+    /// The low 64 bits, for values known to fit.
+    explicit operator long long() const {
+        unsigned long long u = 0;
+        for (size_t i = std::min<size_t>(digits.size(), 2); i-- > 0;) {
+            u = u << DIGIT_BITS | digits[i];
+        }
+
+        return (long long)(negative ? 0ULL - u : u);
+    }
+
+    BigInt operator-() const {
+        BigInt result(*this);
+        result.negative = !negative && !digits.empty();
+
+        return result;
+    }
+
+    friend BigInt operator+(const BigInt& a, const BigInt& b) {
+        if (a.negative == b.negative) {
+            return make(add(a.digits, b.digits), a.negative);
+        }
+        if (compare(a.digits, b.digits) >= 0) {
+            return make(sub(a.digits, b.digits), a.negative);
+        }
+
+        return make(sub(b.digits, a.digits), b.negative);
+    }
+
+    friend BigInt operator-(const BigInt& a, const BigInt& b) {
+        return a + -b;
+    }
+
+    friend BigInt operator*(const BigInt& a, const BigInt& b) {
+        return make(mul(a.digits, b.digits), a.negative != b.negative);
+    }
+
+    friend BigInt operator/(const BigInt& a, const BigInt& b) {
+        return make(divmod(a.digits, b.digits).first,
+                    a.negative != b.negative);
+    }
+
+    friend BigInt operator%(const BigInt& a, const BigInt& b) {
+        return make(divmod(a.digits, b.digits).second, a.negative);
+    }
+
+    BigInt& operator+=(const BigInt& other) { return *this = *this + other; }
+    BigInt& operator-=(const BigInt& other) { return *this = *this - other; }
+    BigInt& operator*=(const BigInt& other) { return *this = *this * other; }
+    BigInt& operator/=(const BigInt& other) { return *this = *this / other; }
+
+    friend bool operator==(const BigInt& a, const BigInt& b) = default;
+
+    friend std::strong_ordering operator<=>(const BigInt& a,
+                                            const BigInt& b) {
+        if (a.negative != b.negative) {
+            return b.negative <=> a.negative;
+        }
+        const auto order = compare(a.digits, b.digits) <=> 0;
+
+        return a.negative ? 0 <=> order : order;
+    }
+
+   private:
+    using Digits = std::vector<uint32_t>;
+
+    static constexpr unsigned DIGIT_BITS = 32;
+
+    static BigInt make(Digits digits, bool negative) {
+        trim(digits);
+        BigInt result;
+        result.negative = negative && !digits.empty();
+        result.digits = std::move(digits);
+
+        return result;
+    }
+
+    static void trim(Digits& d) {
+        while (!d.empty() && d.back() == 0) {
+            d.pop_back();
+        }
+    }
+
+    static int compare(const Digits& a, const Digits& b) {
+        if (a.size() != b.size()) {
+            return a.size() < b.size() ? -1 : 1;
+        }
+        for (size_t i = a.size(); i-- > 0;) {
+            if (a[i] != b[i]) {
+                return a[i] < b[i] ? -1 : 1;
+            }
+        }
+
+        return 0;
+    }
+
+    static Digits add(const Digits& a, const Digits& b) {
+        const auto& [x, y] = a.size() < b.size() ? std::tie(b, a)
+                                                 : std::tie(a, b);
+        Digits result(x.size() + 1);
+        uint64_t carry = 0;
+        for (size_t i = 0; i < x.size(); ++i) {
+            carry += (uint64_t)x[i] + (i < y.size() ? y[i] : 0);
+            result[i] = (uint32_t)carry;
+            carry >>= DIGIT_BITS;
+        }
+        result.back() = (uint32_t)carry;
+
+        return result;
+    }
+
+    /// `a - b` for `a >= b`.
+    static Digits sub(const Digits& a, const Digits& b) {
+        Digits result(a.size());
+        int64_t borrow = 0;
+        for (size_t i = 0; i < a.size(); ++i) {
+            const int64_t cur = (int64_t)a[i] - (i < b.size() ? b[i] : 0) -
+                                borrow;
+            result[i] = (uint32_t)cur;
+            borrow = cur < 0;
+        }
+
+        return result;
+    }
+
+    static Digits mul(const Digits& a, const Digits& b) {
+        if (a.empty() || b.empty()) {
+            return {};
+        }
+
+        Digits result(a.size() + b.size());
+        for (size_t i = 0; i < a.size(); ++i) {
+            uint64_t carry = 0;
+            for (size_t j = 0; j < b.size(); ++j) {
+                carry += (uint64_t)a[i] * b[j] + result[i + j];
+                result[i + j] = (uint32_t)carry;
+                carry >>= DIGIT_BITS;
+            }
+            result[i + b.size()] = (uint32_t)carry;
+        }
+
+        return result;
+    }
+
+    /// Quotient and remainder of the magnitudes by Knuth's algorithm D:
+    /// the divisor is shifted until its top digit has the high bit set, so
+    /// a quotient digit estimated from the top two digits is at most two
+    /// too large.
+    static std::pair<Digits, Digits> divmod(const Digits& u, const Digits& v) {
+        assert(!v.empty());
+        if (compare(u, v) < 0) {
+            return {{}, u};
+        }
+
+        const size_t n = v.size(), m = u.size() - n;
+        if (n == 1) {
+            Digits q(u.size());
+            uint64_t rem = 0;
+            for (size_t i = u.size(); i-- > 0;) {
+                const uint64_t cur = rem << DIGIT_BITS | u[i];
+                q[i] = (uint32_t)(cur / v[0]);
+                rem = cur % v[0];
+            }
+
+            return {q, rem ? Digits{(uint32_t)rem} : Digits{}};
+        }
+
+        const auto s = std::countl_zero(v.back());
+        const auto shifted = [&](const Digits& d, size_t size) {
+            Digits result(size);
+            for (size_t i = 0; i < d.size(); ++i) {
+                const auto wide = (uint64_t)d[i] << s;
+                result[i] |= (uint32_t)wide;
+                if (i + 1 < size) {
+                    result[i + 1] = (uint32_t)(wide >> DIGIT_BITS);
+                }
+            }
+
+            return result;
+        };
+        const auto vn = shifted(v, n);
+        auto un = shifted(u, u.size() + 1);
+
+        Digits q(m + 1);
+        for (size_t j = m + 1; j-- > 0;) {
+            const auto top = (uint64_t)un[j + n] << DIGIT_BITS | un[j + n - 1];
+            uint64_t qhat = top / vn[n - 1], rhat = top % vn[n - 1];
+            while (qhat >> DIGIT_BITS ||
+                   qhat * vn[n - 2] > (rhat << DIGIT_BITS | un[j + n - 2])) {
+                --qhat;
+                rhat += vn[n - 1];
+                if (rhat >> DIGIT_BITS) {
+                    break;
+                }
+            }
+
+            // un[j..j+n] -= qhat * vn, adding vn back if it went negative
+            int64_t borrow = 0;
+            for (size_t i = 0; i < n; ++i) {
+                const uint64_t p = qhat * vn[i];
+                const int64_t t = un[i + j] - borrow - (int64_t)(uint32_t)p;
+                un[i + j] = (uint32_t)t;
+                borrow = (int64_t)(p >> DIGIT_BITS) - (t >> DIGIT_BITS);
+            }
+            const int64_t t = un[j + n] - borrow;
+            un[j + n] = (uint32_t)t;
+            q[j] = (uint32_t)qhat;
+            if (t < 0) {
+                --q[j];
+                uint64_t carry = 0;
+                for (size_t i = 0; i < n; ++i) {
+                    carry += (uint64_t)un[i + j] + vn[i];
+                    un[i + j] = (uint32_t)carry;
+                    carry >>= DIGIT_BITS;
+                }
+                un[j + n] += (uint32_t)carry;
+            }
+        }
+
+        Digits r(n);
+        for (size_t i = 0; i < n; ++i) {
+            const auto pair = (uint64_t)un[i + 1] << DIGIT_BITS | un[i];
+            r[i] = (uint32_t)(pair >> s);
+        }
+        trim(q);
+        trim(r);
+
+        return {q, r};
+    }
+
+    Digits digits;
+    bool negative = false;
+};
+
+/// `*r = a + b`, and whether the sum overflowed `T`. Class types such as
+/// `BigInt` grow instead and never overflow.
+template <typename T>
+bool add_overflow(const T& a, const T& b, T* r) {
+    if constexpr (std::is_class_v<T>) {
+        *r = a + b;
+
+        return false;
+    } else {
+        return __builtin_add_overflow(a, b, r);
+    }
+}
+
+template <typename T>
+bool sub_overflow(const T& a, const T& b, T* r) {
+    if constexpr (std::is_class_v<T>) {
+        *r = a - b;
+
+        return false;
+    } else {
+        return __builtin_sub_overflow(a, b, r);
+    }
+}
+
+template <typename T>
+bool mul_overflow(const T& a, const T& b, T* r) {
+    if constexpr (std::is_class_v<T>) {
+        *r = a * b;
+
+        return false;
+    } else {
+        return __builtin_mul_overflow(a, b, r);
+    }
+}
+
+/// Residue modulo `P`, for counts where a reproducible hash is enough.
+template <uint64_t P>
+class ModInt {
+    static_assert(P > 1 && P < (uint64_t(1) << 63));
+
+   public:
+    ModInt(unsigned long long v = 0) : v(v % P) {}
+
+    ModInt& operator+=(const ModInt& other) {
+        v += other.v;
+        if (v >= P) {
+            v -= P;
+        }
+
+        return *this;
+    }
+
+    friend ModInt operator+(ModInt a, const ModInt& b) { return a += b; }
+
+    ModInt& operator*=(const ModInt& other) {
+        v = (uint64_t)((unsigned __int128)v * other.v % P);
+
+        return *this;
+    }
+
+    friend ModInt operator*(ModInt a, const ModInt& b) { return a *= b; }
+
+    friend bool operator==(const ModInt& a, const ModInt& b) = default;
+
+    uint64_t value() const { return v; }
+
+   private:
+    uint64_t v;
+};
+
+/// Residues modulo several primes `P...`, so the arithmetic stays in 64-bit
+/// words while the value is exact up to the product of the primes. The
+/// value is rebuilt by Garner's mixed-radix reconstruction.
+template <uint64_t... P>
+class MultiModInt {
+    static constexpr size_t K = sizeof...(P);
+    static constexpr std::array<uint64_t, K> PRIMES{P...};
+    static_assert(((P > 1 && P < (uint64_t(1) << 63)) && ...));
+
+   public:
+    MultiModInt(unsigned long long v = 0) : residues{(v % P)...} {}
+
+    MultiModInt& operator+=(const MultiModInt& other) {
+        for (size_t k = 0; k < K; ++k) {
+            residues[k] += other.residues[k];
+            if (residues[k] >= PRIMES[k]) {
+                residues[k] -= PRIMES[k];
+            }
+        }
+
+        return *this;
+    }
+
+    friend MultiModInt operator+(MultiModInt a, const MultiModInt& b) {
+        return a += b;
+    }
+
+    MultiModInt& operator*=(const MultiModInt& other) {
+        for (size_t k = 0; k < K; ++k) {
+            residues[k] = mul_mod(residues[k], other.residues[k], PRIMES[k]);
+        }
+
+        return *this;
+    }
+
+    friend MultiModInt operator*(MultiModInt a, const MultiModInt& b) {
+        return a *= b;
+    }
+
+    friend bool operator==(const MultiModInt& a,
+                           const MultiModInt& b) = default;
+
+    /// x = c_0 + c_1 P_0 + c_2 P_0 P_1 + .., where every digit `c_k` is
+    /// solved modulo `P_k` from the digits before it.
+    BigUint to_big() const {
+        std::array<uint64_t, K> digits{};
+        for (size_t k = 0; k < K; ++k) {
+            const auto p = PRIMES[k];
+
+            // x mod p over the digits so far, and P_0 .. P_{k-1} mod p
+            uint64_t partial = 0, radix = 1;
+            for (size_t j = 0; j < k; ++j) {
+                partial = (partial + mul_mod(digits[j] % p, radix, p)) % p;
+                radix = mul_mod(radix, PRIMES[j] % p, p);
+            }
+
+            // Inverse of the radix by Fermat's little theorem
+            uint64_t inverse = 1;
+            for (auto e = p - 2, base = radix; e > 0; e >>= 1) {
+                if (e & 1) {
+                    inverse = mul_mod(inverse, base, p);
+                }
+                base = mul_mod(base, base, p);
+            }
+
+            digits[k] = mul_mod((residues[k] + p - partial) % p, inverse, p);
+        }
+
+        BigUint result, radix(1);
+        for (size_t k = 0; k < K; ++k) {
+            result += radix * BigUint(digits[k]);
+            radix *= BigUint(PRIMES[k]);
+        }
+
+        return result;
+    }
+
+   private:
+    static uint64_t mul_mod(uint64_t a, uint64_t b, uint64_t p) {
+        return (uint64_t)((unsigned __int128)a * b % p);
+    }
+
+    std::array<uint64_t, K> residues;
+};
+
+std::string count_to_string(long long v) {
+    return std::to_string(v);
+}
+
+std::string count_to_string(__int128 v) {
+    unsigned __int128 u = v < 0 ? -(unsigned __int128)v : (unsigned __int128)v;
+
+    std::string result;
+    do {
+        result.push_back(char('0' + (int)(u % 10)));
+        u /= 10;
+    } while (u);
+    if (v < 0) {
+        result.push_back('-');
+    }
+    std::reverse(result.begin(), result.end());
+
+    return result;
+}
+
+std::string count_to_string(const BigUint& v) {
+    return v.to_string();
+}
+
+template <uint64_t P>
+std::string count_to_string(const ModInt<P>& v) {
+    return std::to_string(v.value());
+}
+
+template <uint64_t... P>
+std::string count_to_string(const MultiModInt<P...>& v) {
+    return v.to_big().to_string();
+}
+
+/// Disjoint-set union over 32-bit indices with iterative path halving and
+/// union by size. Component sizes are kept live, and the sizes of all
+/// non-singleton components are tracked for largest-k queries.
+class UnionFind {
+   public:
+    explicit UnionFind(uint32_t n) : nodes(n), singletons(n), count(n) {
+        for (uint32_t v = 0; v < n; ++v) {
+            nodes[v] = {v, 1};
+        }
+    }
+
+    uint32_t find_set(uint32_t v) {
+        while (nodes[v].parent != v) {
+            nodes[v].parent = nodes[nodes[v].parent].parent;
+            v = nodes[v].parent;
+        }
+
+        return v;
+    }
+
+    bool union_sets(uint32_t a, uint32_t b) {
+        a = find_set(a);
+        b = find_set(b);
+
+        if (a == b) {
+            return false;
+        }
+        if (nodes[a].size < nodes[b].size) {
+            std::swap(a, b);
+        }
+
+        forget_size(nodes[a].size);
+        forget_size(nodes[b].size);
+
+        nodes[b].parent = a;
+        nodes[a].size += nodes[b].size;
+        sizes.insert(nodes[a].size);
+        --count;
+
+        return true;
+    }
+
+    uint32_t component_size(uint32_t v) { return nodes[find_set(v)].size; }
+
+    uint32_t components() const { return count; }
+
+    /// Sizes of the `k` largest components, largest first.
+    std::vector<uint32_t> largest(size_t k) const {
+        std::vector<uint32_t> result;
+        for (auto it = sizes.crbegin();
+             it != sizes.crend() && result.size() < k; ++it) {
+            result.push_back(*it);
+        }
+        while (result.size() < std::min<size_t>(k, sizes.size() + singletons)) {
+            result.push_back(1);
+        }
+
+        return result;
+    }
+
+   private:
+    struct Node {
+        uint32_t parent;
+        uint32_t size;
+    };
+
+    void forget_size(uint32_t size) {
+        if (size == 1) {
+            --singletons;
+        } else {
+            sizes.erase(sizes.find(size));
+        }
+    }
+
+    std::vector<Node> nodes;
+    std::multiset<uint32_t> sizes;
+    uint32_t singletons;
+    uint32_t count;
+};
+
+/// Coordinate compression of `D`-dimensional integer points. Every axis
+/// keeps its sorted distinct values; `compress` returns the lower-bound rank
+/// of a value, through a dense table when the axis range is small enough
+/// for one and by binary search otherwise.
+template <typename T, size_t D>
+class CoordinateCompressor {
+    static_assert(std::is_integral_v<T>);
+
+   public:
+    using Coords = std::array<T, D>;
+    using Ranks = std::array<uint32_t, D>;
+
+    explicit CoordinateCompressor(std::array<std::vector<T>, D> values) {
+        for (size_t a = 0; a < D; ++a) {
+            axes[a].build(std::move(values[a]));
+        }
+    }
+
+    explicit CoordinateCompressor(std::span<const Coords> points)
+        : CoordinateCompressor(axis_values(points)) {}
+
+    size_t size(size_t axis) const { return axes[axis].values.size(); }
+
+    uint32_t compress(size_t axis, T v) const { return axes[axis].rank(v); }
+
+    T restore(size_t axis, uint32_t rank) const {
+        return axes[axis].values[rank];
+    }
+
+    Ranks compress(const Coords& p) const {
+        Ranks result;
+        for (size_t a = 0; a < D; ++a) {
+            result[a] = axes[a].rank(p[a]);
+        }
+
+        return result;
+    }
+
+    Coords restore(const Ranks& r) const {
+        Coords result;
+        for (size_t a = 0; a < D; ++a) {
+            result[a] = axes[a].values[r[a]];
+        }
+
+        return result;
+    }
+
+    std::vector<Ranks> compress_all(std::span<const Coords> points) const {
+        std::vector<Ranks> result(points.size());
+        for (size_t a = 0; a < D; ++a) {
+            for (size_t i = 0; i < points.size(); ++i) {
+                result[i][a] = axes[a].rank(points[i][a]);
+            }
+        }
+
+        return result;
+    }
+
+    std::vector<Coords> restore_all(std::span<const Ranks> ranks) const {
+        std::vector<Coords> result(ranks.size());
+        for (size_t a = 0; a < D; ++a) {
+            for (size_t i = 0; i < ranks.size(); ++i) {
+                result[i][a] = axes[a].values[ranks[i][a]];
+            }
+        }
+
+        return result;
+    }
+
+   private:
+    // A dense table is used while it is at most this many times larger than
+    // the number of distinct values (or small in absolute terms).
+    static constexpr uint64_t DENSE_FACTOR = 8;
+    static constexpr uint64_t DENSE_MIN = 1 << 12;
+
+    struct Axis {
+        std::vector<T> values;
+        std::vector<uint32_t> dense;
+
+        void build(std::vector<T> v) {
+            values = std::move(v);
+            std::sort(values.begin(), values.end());
+            values.erase(std::unique(values.begin(), values.end()),
+                         values.end());
+
+            if (values.empty() ||
+                offset(values.back()) >
+                    std::max(DENSE_FACTOR * values.size(), DENSE_MIN)) {
+                return;
+            }
+
+            dense.resize(offset(values.back()) + 1);
+            uint32_t rank = 0;
+            for (uint64_t d = 0; d < dense.size(); ++d) {
+                if (offset(values[rank]) < d) {
+                    ++rank;
+                }
+                dense[d] = rank;
+            }
+        }
+
+        uint64_t offset(T v) const {
+            return (uint64_t)v - (uint64_t)values.front();
+        }
+
+        uint32_t rank(T v) const {
+            if (!dense.empty()) {
+                if (v < values.front()) {
+                    return 0;
+                }
+                if (v > values.back()) {
+                    return values.size();
+                }
+
+                return dense[offset(v)];
+            }
+
+            return std::lower_bound(values.cbegin(), values.cend(), v) -
+                   values.cbegin();
+        }
+    };
+
+    static std::array<std::vector<T>, D> axis_values(
+        std::span<const Coords> points) {
+        std::array<std::vector<T>, D> values;
+        for (size_t a = 0; a < D; ++a) {
+            values[a].reserve(points.size());
+            for (const auto& p : points) {
+                values[a].push_back(p[a]);
+            }
+        }
+
+        return values;
+    }
+
+    std::array<Axis, D> axes;
+};
+
+/// Dense row-major matrix. Rows are made of cache-line blocks and aligned
+/// to them, so the row kernels are fixed-length loops over contiguous memory
+/// that the compiler vectorises. With a nonzero `MaxCols` every row has room
+/// for that many columns and its length is a compile-time constant; with
+/// `MaxCols == 0` the length is set by `assign` for matrices of any width.
+/// Padding entries stay zero under all row operations.
+template <typename T, size_t MaxCols = 0>
+class Matrix {
+   public:
+    void assign(size_t rows, size_t cols) {
+        assert(MaxCols == 0 || cols <= MaxCols);
+
+        n_rows = rows;
+        n_cols = cols;
+        n_blocks = blocks_for(MaxCols != 0 ? MaxCols : cols);
+        data.assign(rows * n_blocks, Block{});
+    }
+
+    size_t rows() const { return n_rows; }
+    size_t cols() const { return n_cols; }
+
+    T& operator()(size_t r, size_t c) {
+        return row(r)[c / LANES].values[c % LANES];
+    }
+    const T& operator()(size_t r, size_t c) const {
+        return data[r * blocks() + c / LANES].values[c % LANES];
+    }
+
+    void swap_rows(size_t a, size_t b) {
+        std::swap_ranges(row(a), row(a) + blocks(), row(b));
+    }
+
+    /// Row `dst` becomes `a * dst - b * src`. Integer rows are checked for
+    /// overflow, and the result is whether every entry fit in `T`.
+    bool combine(size_t dst, T a, T b, size_t src) {
+        auto* d = row(dst);
+        const auto* s = row(src);
+        if constexpr (std::is_floating_point_v<T>) {
+            for (size_t k = 0; k < blocks(); ++k) {
+                for (size_t c = 0; c < LANES; ++c) {
+                    d[k].values[c] = a * d[k].values[c] - b * s[k].values[c];
+                }
+            }
+
+            return true;
+        } else {
+            bool overflow = false;
+            for (size_t k = 0; k < blocks(); ++k) {
+                for (size_t c = 0; c < LANES; ++c) {
+                    T x, y;
+                    overflow |= mul_overflow(a, d[k].values[c], &x);
+                    overflow |= mul_overflow(b, s[k].values[c], &y);
+                    overflow |= sub_overflow(x, y, &d[k].values[c]);
+                }
+            }
+
+            return !overflow;
+        }
+    }
+
+    /// Divides row `r` by `d`, which for integer `T` must be exact.
+    void divide_row(size_t r, T d) {
+        auto* row_r = row(r);
+        for (size_t k = 0; k < blocks(); ++k) {
+            for (auto& v : row_r[k].values) {
+                assert(std::is_floating_point_v<T> || v % d == 0);
+                v /= d;
+            }
+        }
+    }
+
+    void negate_row(size_t r) {
+        auto* row_r = row(r);
+        for (size_t k = 0; k < blocks(); ++k) {
+            for (auto& v : row_r[k].values) {
+                v = -v;
+            }
+        }
+    }
+
+   private:
+    static constexpr size_t LANES = std::max<size_t>(1, 64 / sizeof(T));
+
+    struct alignas(64) Block {
+        std::array<T, LANES> values{};
+    };
+
+    static constexpr size_t blocks_for(size_t cols) {
+        return (cols + LANES - 1) / LANES;
+    }
+
+    size_t blocks() const {
+        if constexpr (MaxCols != 0) {
+            return blocks_for(MaxCols);
+        } else {
+            return n_blocks;
+        }
+    }
+
+    Block* row(size_t r) { return data.data() + r * blocks(); }
+
+    size_t n_rows = 0;
+    size_t n_cols = 0;
+    size_t n_blocks = 0;
+    std::vector<Block> data;
+};
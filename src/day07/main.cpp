@@ -45,25 +45,29 @@ std::string solve_1(const std::string& input) {
     return std::to_string(ans);
 }
 
+/// `Count` selects the arithmetic for the timeline counts: `long long` for
+/// the common case, `__int128` or `BigUint` for exact results on deep
+/// manifolds, `ModInt<P>` for a reproducible hash of the exact count.
+template <typename Count = long long>
 std::string solve_2(const std::string& input) {
     const auto rows = split_lines_view(input);
     const auto n = rows.size();
     const auto m = rows[0].size();
 
-    std::array<std::vector<long long>, 2> beam;
-    beam[0].assign(m, 0);
-    beam[1].assign(m, 0);
+    std::array<std::vector<Count>, 2> beam;
+    beam[0].assign(m, Count(0));
+    beam[1].assign(m, Count(0));
 
     for (size_t j = 0; j < m; ++j) {
         if (rows[0][j] == 'S') {
-            beam[0][j] = 1;
+            beam[0][j] = Count(1);
 
             break;
         }
     }
 
     for (size_t i = 1; i < n; ++i) {
-        beam[1].assign(m, 0);
+        beam[1].assign(m, Count(0));
 
         for (size_t j = 0; j < m; ++j) {
             if (rows[i][j] == '^') {
@@ -82,9 +86,9 @@ std::string solve_2(const std::string& input) {
     }
 
     const auto ans =
-        std::accumulate(beam[0].cbegin(), beam[0].cend(), (long long)0);
+        std::accumulate(beam[0].cbegin(), beam[0].cend(), Count(0));
 
-    return std::to_string(ans);
+    return count_to_string(ans);
 }
 
 int run_tests() {
@@ -96,6 +100,33 @@ int run_tests() {
     assert(solve_2(readFile(day_path("day07", "in_small.txt"))) == "40");
     assert(solve_2(readFile(day_path("day07", "in.txt"))) == "80158285728929");
 
+    assert(solve_2<__int128>(readFile(day_path("day07", "in.txt"))) ==
+           "80158285728929");
+    assert(solve_2<BigUint>(readFile(day_path("day07", "in.txt"))) ==
+           "80158285728929");
+    assert(solve_2<ModInt<1'000'000'007>>(readFile(
+               day_path("day07", "in.txt"))) == "285167823");
+
+    {
+        // 200 splitter rows: the exact count is far beyond 64 bits
+        const size_t m = 301;
+        std::string deep(m, '.');
+        deep[m / 2] = 'S';
+        for (size_t i = 0; i < 200; ++i) {
+            deep += "\n" + std::string(m, '^') + "\n" + std::string(m, '.');
+        }
+
+        const auto exact = solve_2<BigUint>(deep);
+        assert(exact.size() > 40);
+
+        long long exact_mod = 0;
+        for (const char c : exact) {
+            exact_mod = (exact_mod * 10 + (c - '0')) % 1'000'000'007;
+        }
+        assert(solve_2<ModInt<1'000'000'007>>(deep) ==
+               std::to_string(exact_mod));
+    }
+
     cerr << "All tests passed\n";
 
     return 0;
@@ -1,161 +1,693 @@
 #include <aux.hpp>
 
-class DSU {
-   private:
-    std::vector<size_t> parent;
-    std::vector<size_t> rank;
+struct Point {
+    int x, y, z;
 
-   public:
-    explicit DSU(size_t n) {
-        parent.resize(n + 1);
-        rank.resize(n + 1, 0);
-        std::iota(parent.begin(), parent.end(), 0);
+    Point(int x, int y, int z) : x(x), y(y), z(z) {}
+
+    long long dist_sqr(const Point& other) const {
+        const long long dx = x - other.x;
+        const long long dy = y - other.y;
+        const long long dz = z - other.z;
+
+        return dx * dx + dy * dy + dz * dz;
     }
+};
 
-    ~DSU() = default;
+struct Edge {
+    size_t u, v;
+    long long weight;
 
-    size_t find_set(size_t v) {
-        if (v == parent[v]) {
-            return v;
-        }
+    Edge(size_t u, size_t v, long long weight) : u(u), v(v), weight(weight) {}
+
+    bool operator<(Edge const& other) const { return weight < other.weight; }
+};
+
+/// Pairs as parallel arrays: a 64-bit squared distance and two 32-bit
+/// point indices, 16 bytes per pair.
+struct EdgeStore {
+    std::vector<uint64_t> keys;
+    std::vector<uint32_t> us, vs;
+
+    size_t size() const { return keys.size(); }
 
-        return parent[v] = find_set(parent[v]);
+    void clear() {
+        keys.clear();
+        us.clear();
+        vs.clear();
     }
 
-    bool union_sets(size_t a, size_t b) {
-        a = find_set(a);
-        b = find_set(b);
+    void resize(size_t n) {
+        keys.resize(n);
+        us.resize(n);
+        vs.resize(n);
+    }
+
+    void push_back(uint64_t key, uint32_t u, uint32_t v) {
+        keys.push_back(key);
+        us.push_back(u);
+        vs.push_back(v);
+    }
+};
+
+/// Yields all pairs of points in increasing order of squared distance.
+/// Points are bucketed into a uniform grid and pairs are generated in
+/// batches of doubling radius, so only the consumed prefix is ever built.
+/// Each batch is generated in parallel and distributed into radix buckets
+/// by distance; a bucket is only sorted once it is reached.
+class NearestPairs {
+   public:
+    explicit NearestPairs(const std::vector<Point>& points,
+                          size_t expected_pairs = 0)
+        : points(points) {
+        assert(points.size() < std::numeric_limits<uint32_t>::max());
+
+        if (points.empty()) {
+            exhausted = true;
+
+            return;
+        }
+
+        lo_corner = hi_corner = points[0];
+        for (const auto& p : points) {
+            lo_corner.x = std::min(lo_corner.x, p.x);
+            lo_corner.y = std::min(lo_corner.y, p.y);
+            lo_corner.z = std::min(lo_corner.z, p.z);
+            hi_corner.x = std::max(hi_corner.x, p.x);
+            hi_corner.y = std::max(hi_corner.y, p.y);
+            hi_corner.z = std::max(hi_corner.z, p.z);
+        }
+        max_dist_sqr = lo_corner.dist_sqr(hi_corner);
+
+        // Start with the radius that holds `expected_pairs` pairs for a
+        // uniform cloud over the bounding box.
+        const double n = points.size();
+        const double pairs = std::max<double>(expected_pairs, 1);
+        const double volume =
+            std::max(1.0, (double)hi_corner.x - lo_corner.x) *
+            std::max(1.0, (double)hi_corner.y - lo_corner.y) *
+            std::max(1.0, (double)hi_corner.z - lo_corner.z);
+        radius = std::max(
+            1.0, std::cbrt(1.5 * volume * pairs / (std::numbers::pi * n * n)));
+        min_cell_size = std::max(1LL, (long long)std::cbrt(8 * volume / n));
+    }
 
-        if (a != b) {
-            if (rank[a] < rank[b]) {
-                std::swap(a, b);
+    NearestPairs(const NearestPairs&) = delete;
+    NearestPairs& operator=(const NearestPairs&) = delete;
+
+    std::optional<Edge> next() {
+        while (pos == sorted_end) {
+            if (sorted_end < batch.size()) {
+                select_next();
+            } else if (!exhausted) {
+                next_batch();
+            } else {
+                return std::nullopt;
             }
+        }
+
+        const auto e = Edge(batch.us[pos], batch.vs[pos], batch.keys[pos]);
+        ++pos;
+
+        return e;
+    }
+
+   private:
+    using Cell = std::array<long long, 3>;
+    using Grid = CoordinateCompressor<long long, 3>;
+
+    static constexpr size_t BUCKET_SIZE = 256;
+    static constexpr size_t MIN_POINTS_PER_THREAD = 1 << 14;
+
+    Cell cell_of(const Point& p, long long cell_size) const {
+        return {
+            (p.x - lo_corner.x) / cell_size,
+            (p.y - lo_corner.y) / cell_size,
+            (p.z - lo_corner.z) / cell_size,
+        };
+    }
+
+    // Occupied cells are packed into one sortable key through the ranks of
+    // their coordinates; every axis leaves room for the one-past-last rank.
+    uint64_t key_of(const Grid::Ranks& r) const {
+        return ((uint64_t)r[0] * dims[1] + r[1]) * dims[2] + r[2];
+    }
+
+    Grid::Ranks ranks_of(uint64_t key) const {
+        return {
+            (uint32_t)(key / dims[2] / dims[1]),
+            (uint32_t)(key / dims[2] % dims[1]),
+            (uint32_t)(key % dims[2]),
+        };
+    }
+
+    size_t find_cell(uint64_t key) const {
+        return std::lower_bound(cells.cbegin(), cells.cend(),
+                                std::pair{key, (uint32_t)0}) -
+               cells.cbegin();
+    }
+
+    /// Collects the pairs with `lo < dist_sqr <= hi` into `batch`.
+    void next_batch() {
+        long long hi = (long long)(radius * radius);
+        if (hi >= max_dist_sqr) {
+            hi = max_dist_sqr;
+            exhausted = true;
+        }
+        radius *= 2;
 
-            parent[b] = a;
+        // Cells are never smaller than needed for ~8 points each, so the
+        // per-cell lookups stay cheap when the radius is tiny.
+        const auto cell_size = std::max(
+            min_cell_size, (long long)std::ceil(std::sqrt((double)hi)));
+
+        const auto n = points.size();
+        std::vector<Cell> raw(n);
+        for (size_t i = 0; i < n; ++i) {
+            raw[i] = cell_of(points[i], cell_size);
+        }
+        grid.emplace(raw);
+        for (size_t a = 0; a < 3; ++a) {
+            dims[a] = grid->size(a) + 1;
+        }
 
-            if (rank[a] == rank[b]) {
-                rank[a]++;
+        const auto ranks = grid->compress_all(raw);
+        cells.clear();
+        for (size_t i = 0; i < n; ++i) {
+            cells.push_back({key_of(ranks[i]), (uint32_t)i});
+        }
+        std::sort(cells.begin(), cells.end());
+
+        xs.resize(n);
+        ys.resize(n);
+        zs.resize(n);
+        for (size_t k = 0; k < n; ++k) {
+            const auto& p = points[cells[k].second];
+            xs[k] = p.x;
+            ys[k] = p.y;
+            zs[k] = p.z;
+        }
+
+        const auto threads = worker_count(n, MIN_POINTS_PER_THREAD);
+
+        // Work is split on cell boundaries so every cell has one owner
+        std::vector<size_t> bounds(threads + 1, 0);
+        for (size_t t = 0; t < threads; ++t) {
+            auto end = t + 1 == threads ? n : n * (t + 1) / threads;
+            while (end < n && end > 0 &&
+                   cells[end].first == cells[end - 1].first) {
+                ++end;
             }
+            bounds[t + 1] = std::max(bounds[t], end);
+        }
+
+        std::vector<EdgeStore> local(threads);
+        run_workers(threads, [&](size_t t) {
+            generate(bounds[t], bounds[t + 1], lo, hi, local[t]);
+        });
+
+        distribute(local, lo, hi);
+
+        lo = hi;
+    }
 
-            return true;
+    /// Squared distances from point `i` to points `[begin, end)` in grid
+    /// order. Kept branch-free over the coordinate arrays to vectorise.
+    void dist_sqr_block(size_t i,
+                        size_t begin,
+                        size_t end,
+                        long long* out) const {
+        const long long x = xs[i], y = ys[i], z = zs[i];
+        for (size_t t = begin; t < end; ++t) {
+            const long long dx = xs[t] - x;
+            const long long dy = ys[t] - y;
+            const long long dz = zs[t] - z;
+            out[t - begin] = dx * dx + dy * dy + dz * dz;
         }
-        return false;
     }
-};
 
-class Solver {
-   public:
-    struct Edge {
-        size_t u, v;
-        long long weight;
+    /// Pairs with `lo < dist_sqr <= hi` whose first point lies in one of
+    /// the cells starting in `[begin, end)`. Cells sharing (x, y) are
+    /// contiguous in grid order, so each neighbouring column of up to three
+    /// cells is a single tile of the distance kernel.
+    void generate(size_t begin,
+                  size_t end,
+                  long long lo,
+                  long long hi,
+                  EdgeStore& out) const {
+        std::vector<long long> dist;
+
+        for (size_t a = begin, a_end = begin; a < end; a = a_end) {
+            while (a_end < end && cells[a_end].first == cells[a].first) {
+                ++a_end;
+            }
+            const auto home = grid->restore(ranks_of(cells[a].first));
+
+            // Columns (dx, dy) >= (0, 0), so that each pair is seen once
+            constexpr std::array<std::pair<long long, long long>, 5> columns{{
+                {0, 0},
+                {0, 1},
+                {1, -1},
+                {1, 0},
+                {1, 1},
+            }};
+            for (const auto& [dx, dy] : columns) {
+                const auto rx = grid->compress(0, home[0] + dx);
+                const auto ry = grid->compress(1, home[1] + dy);
+                if (rx == grid->size(0) || ry == grid->size(1) ||
+                    grid->restore(0, rx) != home[0] + dx ||
+                    grid->restore(1, ry) != home[1] + dy) {
+                    continue;
+                }
+
+                const auto rz_lo = grid->compress(2, home[2] - 1);
+                const auto rz_hi = grid->compress(2, home[2] + 2);
+
+                const auto col_begin =
+                    dx == 0 && dy == 0 ? a : find_cell(key_of({rx, ry, rz_lo}));
+                const auto col_end = find_cell(key_of({rx, ry, rz_hi}));
+
+                for (size_t s = a; s < a_end; ++s) {
+                    const auto t_begin = dx == 0 && dy == 0 ? s + 1 : col_begin;
+                    if (t_begin >= col_end) {
+                        continue;
+                    }
+
+                    dist.resize(col_end - t_begin);
+                    dist_sqr_block(s, t_begin, col_end, dist.data());
+
+                    for (size_t t = t_begin; t < col_end; ++t) {
+                        const auto d = dist[t - t_begin];
+                        if (lo < d && d <= hi) {
+                            out.push_back(d, cells[s].second, cells[t].second);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    /// Merges the per-thread pairs into `batch`, grouped by radix buckets
+    /// of equal width over `(lo, hi]`.
+    void distribute(const std::vector<EdgeStore>& local,
+                    long long lo,
+                    long long hi) {
+        size_t total = 0;
+        for (const auto& store : local) {
+            total += store.size();
+        }
 
-        Edge(size_t u, size_t v, long long weight)
-            : u(u), v(v), weight(weight) {}
+        const auto buckets = std::max<size_t>(1, total / BUCKET_SIZE);
+        const auto bucket_of = [&](uint64_t key) {
+            return (size_t)((unsigned __int128)(key - lo - 1) * buckets /
+                            (uint64_t)(hi - lo));
+        };
 
-        bool operator<(Edge const& other) const {
-            return weight < other.weight;
+        bucket_start.assign(buckets + 1, 0);
+        for (const auto& store : local) {
+            for (const auto key : store.keys) {
+                ++bucket_start[bucket_of(key) + 1];
+            }
+        }
+        std::partial_sum(bucket_start.begin(), bucket_start.end(),
+                         bucket_start.begin());
+
+        batch.resize(total);
+        auto fill = bucket_start;
+        for (const auto& store : local) {
+            for (size_t k = 0; k < store.size(); ++k) {
+                const auto at = fill[bucket_of(store.keys[k])]++;
+                batch.keys[at] = store.keys[k];
+                batch.us[at] = store.us[k];
+                batch.vs[at] = store.vs[k];
+            }
         }
-    };
 
-   public:
-    explicit Solver(size_t nodes) : n(nodes), dsu(nodes) {}
+        bucket = 0;
+        pos = 0;
+        sorted_end = 0;
+    }
 
-    ~Solver() = default;
+    /// Sorts the next radix bucket of the batch.
+    void select_next() {
+        const auto begin = bucket_start[bucket];
+        const auto end = bucket_start[bucket + 1];
+        ++bucket;
+
+        scratch.clear();
+        for (size_t k = begin; k < end; ++k) {
+            scratch.push_back(
+                {batch.keys[k], ((uint64_t)batch.us[k] << 32) | batch.vs[k]});
+        }
+        std::sort(scratch.begin(), scratch.end());
+        for (size_t k = begin; k < end; ++k) {
+            batch.keys[k] = scratch[k - begin].first;
+            batch.us[k] = (uint32_t)(scratch[k - begin].second >> 32);
+            batch.vs[k] = (uint32_t)scratch[k - begin].second;
+        }
 
-    void add_edge(size_t u, size_t v, long long weight) {
-        edges.push_back({u, v, weight});
+        sorted_end = end;
     }
 
-    std::pair<size_t, size_t> solve(int connections) {
-        dsu = DSU(n);
+    const std::vector<Point>& points;
+    Point lo_corner{0, 0, 0};
+    Point hi_corner{0, 0, 0};
+    long long max_dist_sqr = 0;
+    long long min_cell_size = 1;
+
+    double radius = 1;
+    long long lo = -1;
+    bool exhausted = false;
+
+    std::optional<Grid> grid;
+    std::array<uint64_t, 3> dims{};
+    std::vector<std::pair<uint64_t, uint32_t>> cells;
+    std::vector<int> xs, ys, zs;
+
+    EdgeStore batch;
+    std::vector<size_t> bucket_start;
+    std::vector<std::pair<uint64_t, uint64_t>> scratch;
+    size_t bucket = 0;
+    size_t pos = 0;
+    size_t sorted_end = 0;
+};
+
+class Solver {
+   public:
+    explicit Solver(size_t nodes) : n(nodes), dsu(nodes) {}
 
-        std::sort(edges.begin(), edges.end());
+    ~Solver() = default;
+
+    std::pair<size_t, size_t> solve(NearestPairs& pairs, int connections) {
+        dsu = UnionFind(n);
 
         std::pair<size_t, size_t> last_connected;
-        for (const Edge& e : edges) {
-            if (connections == 0) {
+        while (connections != 0 && dsu.components() > 1) {
+            const auto e = pairs.next();
+            if (!e) {
                 break;
             }
             --connections;
 
-            if (dsu.union_sets(e.u, e.v)) {
-                last_connected = {e.u, e.v};
+            if (dsu.union_sets(e->u, e->v)) {
+                last_connected = {e->u, e->v};
             }
         }
 
         return last_connected;
     }
 
-    size_t get_component(size_t node) { return dsu.find_set(node); }
+    std::vector<uint32_t> largest_components(size_t k) const {
+        return dsu.largest(k);
+    }
 
    private:
     size_t n;
-    DSU dsu;
-    std::vector<Edge> edges;
+    UnionFind dsu;
 };
 
-struct Point {
-    int x, y, z;
+/// Euclidean minimum spanning tree by Borůvka rounds over a k-d tree.
+/// In each round every component looks up its nearest point outside of
+/// itself; subtrees lying entirely inside the querying component or
+/// farther than the component's best candidate are pruned.
+class EuclideanMST {
+   public:
+    explicit EuclideanMST(const std::vector<Point>& points)
+        : points(points), order(points.size()), comp(points.size()) {
+        std::iota(order.begin(), order.end(), 0);
+        if (!points.empty()) {
+            build(0, points.size());
+        }
+    }
 
-    Point(int x, int y, int z) : x(x), y(y), z(z) {}
+    EuclideanMST(const EuclideanMST&) = delete;
+    EuclideanMST& operator=(const EuclideanMST&) = delete;
 
-    long long dist_sqr(const Point& other) const {
-        const long long dx = x - other.x;
-        const long long dy = y - other.y;
-        const long long dz = z - other.z;
+    std::vector<Edge> solve() {
+        const auto n = points.size();
 
-        return dx * dx + dy * dy + dz * dz;
+        UnionFind dsu(n);
+        std::vector<long long> foreign_lb(n, 0);
+        std::vector<Edge> mst;
+        std::vector<Edge> best;
+
+        size_t components = n;
+        while (components > 1) {
+            for (size_t i = 0; i < n; ++i) {
+                comp[i] = dsu.find_set(i);
+            }
+            for (size_t k = nodes.size(); k-- > 0;) {
+                auto& node = nodes[k];
+                if (node.left == NONE) {
+                    node.comp = comp[order[node.begin]];
+                    for (size_t t = node.begin; t < node.end; ++t) {
+                        if (comp[order[t]] != node.comp) {
+                            node.comp = NONE;
+
+                            break;
+                        }
+                    }
+                } else {
+                    const auto l = nodes[node.left].comp;
+                    node.comp = l == nodes[node.right].comp ? l : NONE;
+                }
+            }
+
+            best.assign(n, Edge(NONE, NONE,
+                                std::numeric_limits<long long>::max()));
+            for (const auto i : order) {
+                auto& b = best[comp[i]];
+                // Components only grow, so the distance from `i` to the
+                // nearest foreign point never decreases between rounds.
+                if (foreign_lb[i] >= b.weight) {
+                    continue;
+                }
+
+                const auto bound = b.weight;
+                nearest(0, i, b);
+                foreign_lb[i] = b.u == i ? b.weight : bound;
+            }
+
+            for (const auto& e : best) {
+                if (e.v != NONE && dsu.union_sets(e.u, e.v)) {
+                    mst.push_back(e);
+                    --components;
+                }
+            }
+        }
+
+        return mst;
     }
-};
 
-std::string solve_1(const std::string& input, size_t connections) {
-    const auto rows = split_lines_view(input);
-    const auto n = rows.size();
+   private:
+    static constexpr size_t NONE = std::numeric_limits<size_t>::max();
+    static constexpr size_t LEAF_SIZE = 8;
+
+    struct Node {
+        std::array<int, 3> lo, hi;
+        size_t begin, end;
+        size_t left = NONE, right = NONE;
+        size_t comp = NONE;
+    };
 
-    std::vector<Point> points;
+    static std::array<int, 3> coords(const Point& p) {
+        return {p.x, p.y, p.z};
+    }
 
-    for (const auto& line : rows) {
-        const auto xyz_str = split_view(line, ",");
+    size_t build(size_t begin, size_t end) {
+        const auto id = nodes.size();
+        nodes.push_back({});
+
+        auto lo = coords(points[order[begin]]);
+        auto hi = lo;
+        for (size_t t = begin; t < end; ++t) {
+            const auto c = coords(points[order[t]]);
+            for (size_t a = 0; a < 3; ++a) {
+                lo[a] = std::min(lo[a], c[a]);
+                hi[a] = std::max(hi[a], c[a]);
+            }
+        }
+        nodes[id].lo = lo;
+        nodes[id].hi = hi;
+        nodes[id].begin = begin;
+        nodes[id].end = end;
+
+        if (end - begin > LEAF_SIZE) {
+            size_t axis = 0;
+            for (size_t a = 1; a < 3; ++a) {
+                if (hi[a] - lo[a] > hi[axis] - lo[axis]) {
+                    axis = a;
+                }
+            }
 
-        points.push_back(Point{
-            parse_from_substr<int>(xyz_str[0]),
-            parse_from_substr<int>(xyz_str[1]),
-            parse_from_substr<int>(xyz_str[2]),
-        });
+            const auto mid = begin + (end - begin) / 2;
+            std::nth_element(order.begin() + begin, order.begin() + mid,
+                             order.begin() + end, [&](size_t a, size_t b) {
+                                 return coords(points[a])[axis] <
+                                        coords(points[b])[axis];
+                             });
+
+            const auto left = build(begin, mid);
+            const auto right = build(mid, end);
+            nodes[id].left = left;
+            nodes[id].right = right;
+        }
+
+        return id;
     }
 
-    Solver mst(n);
-    for (size_t i = 0; i < n; ++i) {
-        for (size_t j = i + 1; j < n; ++j) {
-            mst.add_edge(i, j, points[i].dist_sqr(points[j]));
+    long long box_dist_sqr(const Node& node, const Point& p) const {
+        const auto c = coords(p);
+
+        long long d = 0;
+        for (size_t a = 0; a < 3; ++a) {
+            long long delta = 0;
+            if (c[a] < node.lo[a]) {
+                delta = node.lo[a] - c[a];
+            } else if (c[a] > node.hi[a]) {
+                delta = c[a] - node.hi[a];
+            }
+            d += delta * delta;
         }
+
+        return d;
     }
 
-    mst.solve((int)connections);
+    /// Improves `best` with the nearest point to `i` outside its component.
+    void nearest(size_t id, size_t i, Edge& best) const {
+        const auto& node = nodes[id];
+        if (node.comp == comp[i] ||
+            box_dist_sqr(node, points[i]) >= best.weight) {
+            return;
+        }
 
-    std::map<int, long long> sizes;
-    for (size_t i = 0; i < n; ++i) {
-        const auto comp = mst.get_component(i);
-        ++sizes[comp];
+        if (node.left == NONE) {
+            for (size_t t = node.begin; t < node.end; ++t) {
+                const auto j = order[t];
+                if (comp[j] == comp[i]) {
+                    continue;
+                }
+
+                const auto d = points[i].dist_sqr(points[j]);
+                if (d < best.weight) {
+                    best = Edge(i, j, d);
+                }
+            }
+
+            return;
+        }
+
+        auto first = node.left;
+        auto second = node.right;
+        if (box_dist_sqr(nodes[second], points[i]) <
+            box_dist_sqr(nodes[first], points[i])) {
+            std::swap(first, second);
+        }
+        nearest(first, i, best);
+        nearest(second, i, best);
     }
 
-    std::vector<long long> sizes_sorted(sizes.size());
-    std::transform(sizes.cbegin(), sizes.cend(), sizes_sorted.begin(),
-                   [](const auto& e) { return e.second; });
+    const std::vector<Point>& points;
+    std::vector<size_t> order;
+    std::vector<size_t> comp;
+    std::vector<Node> nodes;
+};
 
-    std::sort(sizes_sorted.begin(), sizes_sorted.end(), std::greater<>());
+/// Answers "product of the three largest circuits after k connections" for
+/// many k in a single Kruskal sweep. Only the `capacity` shortest pairs are
+/// materialised; an appended point merges its own pairs into that prefix
+/// instead of rebuilding it.
+class Circuits {
+   public:
+    explicit Circuits(std::vector<Point> points) : points(std::move(points)) {}
 
-    long long ans = 1;
-    for (auto i = 0; i < 3; ++i) {
-        ans *= sizes_sorted[i];
+    Circuits(const Circuits&) = delete;
+    Circuits& operator=(const Circuits&) = delete;
+
+    void add_point(const Point& p) {
+        const auto id = points.size();
+        points.push_back(p);
+
+        // A full prefix only takes pairs shorter than its current last one;
+        // a partial prefix already holds every pair and takes them all.
+        const bool full = edges.size() == capacity;
+
+        std::vector<Edge> fresh;
+        for (size_t i = 0; i < id; ++i) {
+            const auto d = p.dist_sqr(points[i]);
+            if (!full || (!edges.empty() && d < edges.back().weight)) {
+                fresh.push_back({i, id, d});
+            }
+        }
+        std::sort(fresh.begin(), fresh.end());
+
+        const auto mid = edges.size();
+        edges.insert(edges.end(), fresh.cbegin(), fresh.cend());
+        std::inplace_merge(edges.begin(), edges.begin() + mid, edges.end());
+        if (edges.size() > capacity) {
+            edges.erase(edges.begin() + capacity, edges.end());
+        }
     }
 
-    return std::to_string(ans);
-}
+    /// Product of the three largest circuits after each of `connections`.
+    std::vector<long long> products(const std::vector<size_t>& connections) {
+        if (connections.empty()) {
+            return {};
+        }
 
-std::string solve_2(const std::string& input) {
+        const auto most =
+            *std::max_element(connections.cbegin(), connections.cend());
+        if (most > capacity) {
+            materialise(std::max(most, 2 * capacity));
+        }
+
+        std::vector<size_t> order(connections.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return connections[a] < connections[b];
+        });
+
+        UnionFind dsu(points.size());
+        std::vector<long long> result(connections.size());
+
+        size_t done = 0;
+        for (const auto q : order) {
+            for (; done < connections[q] && done < edges.size(); ++done) {
+                dsu.union_sets(edges[done].u, edges[done].v);
+            }
+
+            long long ans = 1;
+            for (const auto size : dsu.largest(3)) {
+                ans *= size;
+            }
+            result[q] = ans;
+        }
+
+        return result;
+    }
+
+   private:
+    void materialise(size_t k) {
+        capacity = k;
+        edges.clear();
+
+        NearestPairs pairs(points, k);
+        while (edges.size() < k) {
+            const auto e = pairs.next();
+            if (!e) {
+                break;
+            }
+            edges.push_back(*e);
+        }
+    }
+
+    std::vector<Point> points;
+    std::vector<Edge> edges;
+    size_t capacity = 0;
+};
+
+std::vector<Point> parse_points(const std::string& input) {
     const auto rows = split_lines_view(input);
-    const auto n = rows.size();
 
     std::vector<Point> points;
 
@@ -169,17 +701,39 @@ std::string solve_2(const std::string& input) {
         });
     }
 
+    return points;
+}
+
+std::string solve_1(const std::string& input, size_t connections) {
+    const auto points = parse_points(input);
+    const auto n = points.size();
+
+    NearestPairs pairs(points, connections);
     Solver mst(n);
-    for (size_t i = 0; i < n; ++i) {
-        for (size_t j = i + 1; j < n; ++j) {
-            mst.add_edge(i, j, points[i].dist_sqr(points[j]));
-        }
+    mst.solve(pairs, (int)connections);
+
+    long long ans = 1;
+    for (const auto size : mst.largest_components(3)) {
+        ans *= size;
     }
 
-    const auto last_connected = mst.solve((int)-1);
+    return std::to_string(ans);
+}
+
+std::string solve_2(const std::string& input) {
+    const auto points = parse_points(input);
+
+    EuclideanMST mst(points);
+    const auto edges = mst.solve();
 
-    const auto ans = (long long)points[last_connected.first].x *
-                     (long long)points[last_connected.second].x;
+    // The last edge Kruskal would add is the heaviest edge of the MST. A
+    // single point is connected from the start, like a pair with itself.
+    const auto last_connected =
+        edges.empty() ? Edge(0, 0, 0)
+                      : *std::max_element(edges.cbegin(), edges.cend());
+
+    const auto ans = (long long)points[last_connected.u].x *
+                     (long long)points[last_connected.v].x;
 
     return std::to_string(ans);
 }
@@ -192,6 +746,20 @@ int run_tests() {
 
     assert(solve_2(readFile(day_path("day08", "in_small.txt"))) == "25272");
     assert(solve_2(readFile(day_path("day08", "in.txt"))) == "3200955921");
+    assert(solve_2("7,1,2") == "49");
+
+    {
+        const auto points = parse_points(readFile(day_path("day08", "in.txt")));
+
+        Circuits circuits({points.begin(), points.begin() + 600});
+        assert(circuits.products({500, 2000}) ==
+               (vector<long long>{10120, 1194}));
+        for (size_t i = 600; i < points.size(); ++i) {
+            circuits.add_point(points[i]);
+        }
+        assert(circuits.products({1000, 100, 2000}) ==
+               (vector<long long>{175440, 27, 343140}));
+    }
 
     cerr << "All tests passed\n";
 
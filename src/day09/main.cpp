@@ -15,30 +15,17 @@ struct Point {
 
 class Compressed2D {
    public:
-    explicit Compressed2D(const std::vector<Point>& points) {
-        xs.reserve(points.size() * 3);
-        ys.reserve(points.size() * 3);
-
+    explicit Compressed2D(const std::vector<Point>& points)
+        : coords(axis_values(points)) {
+        std::vector<std::array<int, 2>> original;
+        original.reserve(points.size());
         for (const auto& p : points) {
-            xs.push_back(p.x);
-            ys.push_back(p.y);
-
-            xs.push_back(p.x - 1);
-            xs.push_back(p.x + 1);
-
-            ys.push_back(p.y - 1);
-            ys.push_back(p.y + 1);
+            original.push_back({p.x, p.y});
         }
 
-        std::sort(xs.begin(), xs.end());
-        std::sort(ys.begin(), ys.end());
-
-        xs.erase(std::unique(xs.begin(), xs.end()), xs.end());
-        ys.erase(std::unique(ys.begin(), ys.end()), ys.end());
-
         compressed_points.reserve(points.size());
-        for (const auto& p : points) {
-            compressed_points.push_back({compressX(p.x), compressY(p.y)});
+        for (const auto& r : coords.compress_all(original)) {
+            compressed_points.push_back({(int)r[0], (int)r[1]});
         }
     }
 
@@ -49,31 +36,115 @@ class Compressed2D {
     Compressed2D& operator=(Compressed2D&&) = default;
 
     Point originalByIndex(size_t i) const {
-        return Point{xs[compressed_points[i].x], ys[compressed_points[i].y]};
+        return Point{restoreX(compressed_points[i].x),
+                     restoreY(compressed_points[i].y)};
     };
 
-    int restoreX(int cy) const { return xs[cy]; }
-    int restoreY(int cy) const { return ys[cy]; }
+    int restoreX(int cx) const { return coords.restore(0, cx); }
+    int restoreY(int cy) const { return coords.restore(1, cy); }
 
     size_t size() const { return compressed_points.size(); }
+    size_t width() const { return coords.size(0); }
+    size_t height() const { return coords.size(1); }
 
     Point operator[](size_t index) const { return compressed_points[index]; }
 
    private:
-    int compressX(int v) const {
-        return std::lower_bound(xs.begin(), xs.end(), v) - xs.begin();
-    }
+    static std::array<std::vector<int>, 2> axis_values(
+        const std::vector<Point>& points) {
+        std::array<std::vector<int>, 2> values;
+        values[0].reserve(points.size() * 3);
+        values[1].reserve(points.size() * 3);
+
+        for (const auto& p : points) {
+            values[0].push_back(p.x);
+            values[1].push_back(p.y);
+
+            values[0].push_back(p.x - 1);
+            values[0].push_back(p.x + 1);
+
+            values[1].push_back(p.y - 1);
+            values[1].push_back(p.y + 1);
+        }
 
-    int compressY(int v) const {
-        return std::lower_bound(ys.begin(), ys.end(), v) - ys.begin();
+        return values;
     }
 
    private:
-    std::vector<int> xs;
-    std::vector<int> ys;
+    CoordinateCompressor<int, 2> coords;
     std::vector<Point> compressed_points;
 };
 
+/// Pareto-minimal points: sorted by increasing x and decreasing y.
+std::vector<Point> lower_staircase(std::vector<Point> points) {
+    std::sort(points.begin(), points.end(), [](const auto& a, const auto& b) {
+        return std::pair{a.x, a.y} < std::pair{b.x, b.y};
+    });
+
+    std::vector<Point> result;
+    for (const auto& p : points) {
+        if (result.empty() || p.y < result.back().y) {
+            result.push_back(p);
+        }
+    }
+
+    return result;
+}
+
+/// Pareto-maximal points: sorted by increasing x and decreasing y.
+std::vector<Point> upper_staircase(std::vector<Point> points) {
+    std::sort(points.begin(), points.end(), [](const auto& a, const auto& b) {
+        return std::pair{a.x, a.y} > std::pair{b.x, b.y};
+    });
+
+    std::vector<Point> result;
+    for (const auto& p : points) {
+        if (result.empty() || p.y > result.back().y) {
+            result.push_back(p);
+        }
+    }
+    std::reverse(result.begin(), result.end());
+
+    return result;
+}
+
+/// Largest rectangle spanned by a point of `lower` as its bottom-left
+/// corner and a point of `upper` as its top-right corner. The best partner
+/// in `upper` only moves right as the corner in `lower` does, so a monotone
+/// divide and conquer over `lower` needs O(n log n) evaluations.
+long long max_rect_between(const std::vector<Point>& lower,
+                           const std::vector<Point>& upper) {
+    const auto area = [](const Point& p, const Point& q) {
+        return ((long long)q.x - p.x + 1) * ((long long)q.y - p.y + 1);
+    };
+
+    long long best = 0;
+    const auto search = [&](auto& self, size_t lo, size_t hi, size_t opt_lo,
+                            size_t opt_hi) -> void {
+        if (lo >= hi) {
+            return;
+        }
+
+        const auto mid = lo + (hi - lo) / 2;
+        auto opt = opt_lo;
+        auto mid_best = std::numeric_limits<long long>::min();
+        for (auto j = opt_lo; j <= opt_hi; ++j) {
+            const auto cur = area(lower[mid], upper[j]);
+            if (cur > mid_best) {
+                mid_best = cur;
+                opt = j;
+            }
+        }
+        best = std::max(best, mid_best);
+
+        self(self, lo, mid, opt_lo, opt);
+        self(self, mid + 1, hi, opt, opt_hi);
+    };
+    search(search, 0, lower.size(), 0, upper.size() - 1);
+
+    return best;
+}
+
 std::string solve_1(const std::string& input) {
     const auto rows = split_lines_view(input);
     const auto n = rows.size();
@@ -88,60 +159,210 @@ std::string solve_1(const std::string& input) {
         });
     }
 
-    long long ans = 0;
-    for (size_t i = 0; i < n; ++i) {
-        for (size_t j = i + 1; j < n; ++j) {
-            ans = std::max(ans, points[i].rect_sqr(points[j]));
-        }
+    if (n < 2) {
+        return "0";
+    }
+
+    // The best pair spans either the main or the anti-diagonal; mirroring
+    // y turns the second case into the first.
+    auto ans =
+        max_rect_between(lower_staircase(points), upper_staircase(points));
+
+    for (auto& p : points) {
+        p.y = -p.y;
     }
+    ans = std::max(ans, max_rect_between(lower_staircase(points),
+                                         upper_staircase(points)));
 
     return std::to_string(ans);
 }
 
-bool on_segment(const Point& p, const Point& q, const Point& r) {
-    if (q.x < std::min(p.x, r.x) || q.x > std::max(p.x, r.x)) {
-        return false;
+/// Slab index of a rectilinear polygon for O(log n) point-in-polygon and
+/// segment-inside queries; the boundary counts as inside. Distinct vertex
+/// rows cut the plane into horizontal slabs, and every row and slab keeps
+/// its sorted inside spans. Vertical segments go to a transposed copy.
+class PolygonIndex {
+   public:
+    explicit PolygonIndex(const std::vector<Point>& polygon)
+        : by_row(polygon, false), by_col(polygon, true) {}
+
+    bool contains(const Point& p) const {
+        return by_row.covers(p.y, p.x, p.x);
     }
-    if (q.y < std::min(p.y, r.y) || q.y > std::max(p.y, r.y)) {
-        return false;
+
+    std::vector<bool> contains(const std::vector<Point>& ps) const {
+        std::vector<bool> result(ps.size());
+        for (size_t i = 0; i < ps.size(); ++i) {
+            result[i] = contains(ps[i]);
+        }
+
+        return result;
     }
 
-    return ((r.x - p.x) * (q.y - p.y) == (q.x - p.x) * (r.y - p.y));
-}
+    /// Whether the axis-aligned segment `ab` lies inside the polygon.
+    bool contains_segment(const Point& a, const Point& b) const {
+        if (a.y == b.y) {
+            return by_row.covers(a.y, std::min(a.x, b.x), std::max(a.x, b.x));
+        }
+        assert(a.x == b.x);
+
+        return by_col.covers(a.x, std::min(a.y, b.y), std::max(a.y, b.y));
+    }
+
+    /// Closed x-intervals of row `y` that lie inside the polygon.
+    std::span<const std::pair<int, int>> row_spans(int y) const {
+        return by_row.spans_at(y);
+    }
+
+   private:
+    /// Inside spans of every line of one axis. Line `2k` is the `k`-th
+    /// distinct vertex row, line `2k + 1` the open slab above it.
+    struct Slabs {
+        Slabs(const std::vector<Point>& polygon, bool transpose) {
+            const auto row = [&](const Point& p) {
+                return transpose ? p.x : p.y;
+            };
+            const auto col = [&](const Point& p) {
+                return transpose ? p.y : p.x;
+            };
+
+            for (const auto& p : polygon) {
+                rows.push_back(row(p));
+            }
+            std::sort(rows.begin(), rows.end());
+            rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+
+            // Edges across the rows cross every slab between their ends
+            std::vector<std::vector<int>> crossing(rows.size());
+            const auto n = polygon.size();
+            for (size_t i = 0, j = n - 1; i < n; j = i++) {
+                const auto& a = polygon[j];
+                const auto& b = polygon[i];
+                if (row(a) == row(b)) {
+                    continue;
+                }
+
+                const auto lo = find_row(std::min(row(a), row(b)));
+                const auto hi = find_row(std::max(row(a), row(b)));
+                for (auto k = lo; k < hi; ++k) {
+                    crossing[k].push_back(col(a));
+                }
+            }
+
+            std::vector<std::pair<int, int>> above, below;
+            begin.push_back(0);
+            for (size_t k = 0; k < rows.size(); ++k) {
+                auto& xs = crossing[k];
+                std::sort(xs.begin(), xs.end());
+
+                below = above;
+                above.clear();
+                for (size_t t = 0; t + 1 < xs.size(); t += 2) {
+                    above.push_back({xs[t], xs[t + 1]});
+                }
+
+                // A vertex row is inside wherever a neighbouring slab is
+                std::vector<std::pair<int, int>> merged(below.size() +
+                                                        above.size());
+                std::merge(below.cbegin(), below.cend(), above.cbegin(),
+                           above.cend(), merged.begin());
+                for (const auto& span : merged) {
+                    if (spans.size() > begin.back() &&
+                        span.first <= spans.back().second) {
+                        spans.back().second =
+                            std::max(spans.back().second, span.second);
+                    } else {
+                        spans.push_back(span);
+                    }
+                }
+                begin.push_back(spans.size());
+
+                spans.insert(spans.end(), above.cbegin(), above.cend());
+                begin.push_back(spans.size());
+            }
+        }
+
+        size_t find_row(int y) const {
+            return std::lower_bound(rows.cbegin(), rows.cend(), y) -
+                   rows.cbegin();
+        }
 
-bool point_in_polygon(const std::vector<Point>& poly, const Point& p) {
-    bool inside = false;
-    int n = poly.size();
+        std::span<const std::pair<int, int>> spans_at(int y) const {
+            const auto k = find_row(y);
+            if (k == rows.size() || (k == 0 && rows[0] != y)) {
+                return {};
+            }
 
-    for (int i = 0, j = n - 1; i < n; j = i++) {
-        const Point& a = poly[j];
-        const Point& b = poly[i];
+            const auto line = rows[k] == y ? 2 * k : 2 * k - 1;
 
-        if (on_segment(a, p, b)) {
-            return true;
+            return {spans.data() + begin[line], spans.data() + begin[line + 1]};
         }
 
-        long long ay = a.y, by = b.y;
-        long long ax = a.x, bx = b.x;
-        if (ay > by) {
-            std::swap(ay, by);
-            std::swap(ax, bx);
+        bool covers(int y, int x0, int x1) const {
+            const auto line = spans_at(y);
+            auto it = std::upper_bound(
+                line.begin(), line.end(), x0,
+                [](int x, const auto& span) { return x < span.first; });
+            if (it == line.begin()) {
+                return false;
+            }
+            --it;
+
+            return x1 <= it->second;
         }
 
-        if (p.y > ay && p.y <= by) {
-            long long dx = bx - ax;
-            long long dy = by - ay;
-            long long qy = p.y - ay;
+        std::vector<int> rows;
+        std::vector<size_t> begin;
+        std::vector<std::pair<int, int>> spans;
+    };
 
-            long long intersectX = ax + dx * qy / dy;
+    Slabs by_row;
+    Slabs by_col;
+};
 
-            if (p.x <= intersectX) {
-                inside = !inside;
+/// Inside/outside mask of a rectilinear polygon over the `Compressed2D`
+/// grid, rasterised row by row from the polygon's inside spans, with a 2D
+/// prefix sum of the outside cells so that any rectangle of cells is
+/// validated in O(1). Boundary cells count as inside.
+class InsideMask {
+   public:
+    InsideMask(const Compressed2D& grid, const PolygonIndex& polygon)
+        : w(grid.width()), h(grid.height()) {
+        outside_prefix.assign((w + 1) * (h + 1), 0);
+        for (size_t y = 0; y < h; ++y) {
+            const auto spans = polygon.row_spans(grid.restoreY(y));
+
+            auto span = spans.begin();
+            for (size_t x = 0; x < w; ++x) {
+                const auto rx = grid.restoreX(x);
+                while (span != spans.end() && span->second < rx) {
+                    ++span;
+                }
+                const bool outside = span == spans.end() || rx < span->first;
+
+                outside_prefix[(y + 1) * (w + 1) + x + 1] =
+                    outside + outside_prefix[y * (w + 1) + x + 1] +
+                    outside_prefix[(y + 1) * (w + 1) + x] -
+                    outside_prefix[y * (w + 1) + x];
             }
         }
     }
-    return inside;
-}
+
+    /// Whether every cell of `[x0, x1] x [y0, y1]` is inside the polygon.
+    bool all_inside(int x0, int y0, int x1, int y1) const {
+        const auto at = [&](int x, int y) {
+            return outside_prefix[(size_t)y * (w + 1) + x];
+        };
+
+        return at(x1 + 1, y1 + 1) - at(x0, y1 + 1) - at(x1 + 1, y0) +
+                   at(x0, y0) ==
+               0;
+    }
+
+   private:
+    size_t w, h;
+    std::vector<uint32_t> outside_prefix;
+};
 
 std::string solve_2(const std::string& input) {
     const auto rows = split_lines_view(input);
@@ -157,44 +378,70 @@ std::string solve_2(const std::string& input) {
     }
 
     Compressed2D compressed(points);
+    PolygonIndex polygon(points);
+    InsideMask inside(compressed, polygon);
+
+    // Candidates by decreasing area: the first valid one is the answer, so
+    // workers stop as soon as the next chunk cannot beat the shared best.
+    struct Candidate {
+        long long area;
+        uint32_t i, j;
+    };
 
-    long long ans = 0;
+    std::vector<Candidate> candidates;
+    candidates.reserve(compressed.size() * (compressed.size() - 1) / 2);
     for (size_t i = 0; i < compressed.size(); ++i) {
         for (size_t j = i + 1; j < compressed.size(); ++j) {
-            const auto pi = compressed.originalByIndex(i);
-            const auto pj = compressed.originalByIndex(j);
-
-            const auto mi_x = std::min(compressed[i].x, compressed[j].x);
-            const auto ma_x = std::max(compressed[i].x, compressed[j].x);
-            const auto mi_y = std::min(compressed[i].y, compressed[j].y);
-            const auto ma_y = std::max(compressed[i].y, compressed[j].y);
-
-            bool all = true;
-
-            for (int x = mi_x; x <= ma_x && all; ++x) {
-                all &= point_in_polygon(points,
-                                        Point{
-                                            compressed.restoreX(x),
-                                            pi.y,
-                                        }) &
-                       point_in_polygon(points, Point{
-                                                    compressed.restoreX(x),
-                                                    pj.y,
-                                                });
-            }
+            candidates.push_back({points[i].rect_sqr(points[j]), (uint32_t)i,
+                                  (uint32_t)j});
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [](const auto& a, const auto& b) { return a.area > b.area; });
+
+    const auto valid = [&](const Candidate& c) {
+        const auto mi_x = std::min(compressed[c.i].x, compressed[c.j].x);
+        const auto ma_x = std::max(compressed[c.i].x, compressed[c.j].x);
+        const auto mi_y = std::min(compressed[c.i].y, compressed[c.j].y);
+        const auto ma_y = std::max(compressed[c.i].y, compressed[c.j].y);
 
-            for (int y = mi_y; y <= ma_y && all; ++y) {
-                all &= point_in_polygon(points,
-                                        Point{pi.x, compressed.restoreY(y)}) &
-                       point_in_polygon(points,
-                                        Point{pj.x, compressed.restoreY(y)});
+        return inside.all_inside(mi_x, mi_y, ma_x, ma_y);
+    };
+
+    constexpr size_t CHUNK = 1 << 10;
+
+    std::atomic<size_t> next_chunk = 0;
+    std::atomic<long long> best = 0;
+    const auto worker = [&](size_t) {
+        while (true) {
+            const auto begin = next_chunk.fetch_add(CHUNK);
+            if (begin >= candidates.size() ||
+                candidates[begin].area <= best.load()) {
+                return;
             }
 
-            if (all) {
-                ans = std::max(ans, pi.rect_sqr(pj));
+            const auto end = std::min(candidates.size(), begin + CHUNK);
+            for (size_t k = begin; k < end; ++k) {
+                const auto& c = candidates[k];
+                if (c.area <= best.load()) {
+                    break;
+                }
+                if (valid(c)) {
+                    auto cur = best.load();
+                    while (cur < c.area &&
+                           !best.compare_exchange_weak(cur, c.area)) {
+                    }
+
+                    break;
+                }
             }
         }
-    }
+    };
+
+    run_workers(worker_count(candidates.size(), 16 * CHUNK), worker);
+
+    const auto ans = best.load();
+
     return std::to_string(ans);
 }
 
@@ -207,6 +454,26 @@ int run_tests() {
     assert(solve_2(readFile(day_path("day09", "in_small.txt"))) == "24");
     assert(solve_2(readFile(day_path("day09", "in.txt"))) == "1652344888");
 
+    {
+        const PolygonIndex polygon({{7, 1}, {11, 1}, {11, 7}, {9, 7},
+                                    {9, 5}, {2, 5}, {2, 3}, {7, 3}});
+
+        assert(polygon.contains(Point{8, 4}));
+        assert(polygon.contains(Point{2, 4}));
+        assert(polygon.contains(Point{11, 7}));
+        assert(!polygon.contains(Point{3, 2}));
+        assert(!polygon.contains(Point{10, 8}));
+        assert((polygon.contains({{7, 1}, {1, 1}, {9, 6}}) ==
+                vector<bool>{true, false, true}));
+
+        assert(polygon.contains_segment({2, 5}, {9, 5}));
+        assert(polygon.contains_segment({9, 2}, {9, 7}));
+        assert(polygon.contains_segment({2, 3}, {11, 3}));
+        assert(!polygon.contains_segment({2, 6}, {11, 6}));
+        assert(!polygon.contains_segment({8, 5}, {8, 6}));
+        assert(!polygon.contains_segment({5, 1}, {5, 5}));
+    }
+
     cerr << "All tests passed\n";
 
     return 0;
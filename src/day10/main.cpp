@@ -1,345 +1,761 @@
 #include <aux.hpp>
 
-typedef long double f64;
-
-constexpr f64 EPS = 1e-9;
-
 class Machine {
    public:
     static Machine parse_machine(const std::string_view line) {
         Machine result;
+        parse_machine(line, result);
 
-        // Extract the [...] part
-        {
-            const std::regex r_brackets(R"br(\[([^\]]*)\])br");
-            std::match_results<std::string_view::const_iterator> m;
-
-            const auto found =
-                std::regex_search(line.begin(), line.end(), m, r_brackets);
-            assert(found);
-
-            int state = 0;
-            const auto& s = m[1].str();
-            const auto n = m[1].length();
-            result.lights = n;
-            for (ptrdiff_t i = 0; i < n; ++i) {
-                if (s[i] == '#') {
-                    state |= (1 << i);
+        return result;
+    }
+
+    /// Single pass over `[.##.] (0,2) (1,3) {3,5,4,7}`, reusing the buffers
+    /// of `out` so that parsing many lines does not allocate. Spaces inside
+    /// the groups are skipped, and a truncated line ends its last group.
+    /// Lights are the bits of one word, so a machine has at most 64.
+    static void parse_machine(const std::string_view line, Machine& out) {
+        out.lights = 0;
+        out.state = 0;
+        out.buttons.clear();
+        out.joltage.clear();
+
+        const auto end = line.data() + line.size();
+        const auto read_number = [&](const char*& at) {
+            int value = 0;
+            const auto r = std::from_chars(at, end, value);
+            assert(r.ec == std::errc());
+            at = r.ec == std::errc() ? r.ptr : at + 1;
+
+            return value;
+        };
+
+        for (auto at = line.data(); at < end;) {
+            switch (*at) {
+                case '[':
+                    for (++at; at < end && *at != ']'; ++at, ++out.lights) {
+                        if (*at == '#') {
+                            out.state |= uint64_t(1) << out.lights;
+                        }
+                    }
+                    assert(out.lights <= 64);
+
+                    break;
+                case '(': {
+                    uint64_t button = 0;
+                    for (++at; at < end && *at != ')';) {
+                        if (*at == ',' || *at == ' ') {
+                            ++at;
+                        } else {
+                            const auto light = read_number(at);
+                            assert(0 <= light && light < 64);
+                            button |= uint64_t(1) << light;
+                        }
+                    }
+                    out.buttons.push_back(button);
+
+                    break;
                 }
-            }
+                case '{':
+                    for (++at; at < end && *at != '}';) {
+                        if (*at == ',' || *at == ' ') {
+                            ++at;
+                        } else {
+                            out.joltage.push_back(read_number(at));
+                        }
+                    }
 
-            result.state = state;
+                    break;
+                default:
+                    // Separators and the closing bracket of a group
+                    ++at;
+            }
         }
+    }
 
-        // Extract all (...) parts
-        {
-            const std::regex r_paren(R"par(\(([^)]*)\))par");
-            auto begin = std::regex_iterator(line.begin(), line.end(), r_paren);
-            auto end = std::regex_iterator<std::string_view::const_iterator>();
+    /// Fewest presses by breadth-first search over all `2^lights` states,
+    /// kept as bitsets. Pressing `button` maps state `s` to `s ^ button`,
+    /// a fixed permutation of bit positions, so every level is expanded
+    /// whole: the high bits of the button pick the target word and the low
+    /// six are butterfly swaps inside it.
+    int solve() const {
+        assert(lights <= 32);
+        const auto words = std::max<size_t>(1, (size_t(1) << lights) / 64);
 
-            for (auto it = begin; it != end; ++it) {
-                auto sub = (*it)[1];
+        std::vector<uint64_t> seen(words, 0), frontier(words, 0), next(words);
+        seen[0] = frontier[0] = 1;
 
-                std::vector<int> nums;
-                if (sub.first != sub.second) {
-                    std::string inside(sub.first, sub.second);
-                    std::stringstream ss(inside);
-                    std::string token;
+        for (int depth = 0;; ++depth) {
+            if ((frontier[state / 64] >> (state % 64)) & 1) {
+                return depth;
+            }
+
+            std::fill(next.begin(), next.end(), 0);
+            for (const auto button : buttons) {
+                const auto hi = button / 64;
+                const auto lo = button % 64;
+
+                for (size_t w = 0; w < words; ++w) {
+                    auto bits = frontier[w];
+                    if (bits == 0) {
+                        continue;
+                    }
 
-                    while (std::getline(ss, token, ',')) {
-                        nums.push_back(std::stoi(token));
+                    for (auto rest = lo; rest != 0; rest &= rest - 1) {
+                        const auto k = std::countr_zero(rest);
+                        bits = ((bits & SWAP_MASKS[k]) << (1 << k)) |
+                               ((bits >> (1 << k)) & SWAP_MASKS[k]);
                     }
+                    next[w ^ hi] |= bits;
                 }
-                int button = 0;
-                const auto n = nums.size();
-                for (size_t i = 0; i < n; ++i) {
-                    button |= (1 << nums[i]);
-                };
-                result.buttons.push_back(button);
             }
+
+            bool grown = false;
+            for (size_t w = 0; w < words; ++w) {
+                next[w] &= ~seen[w];
+                seen[w] |= next[w];
+                grown |= next[w] != 0;
+            }
+            assert(grown);
+
+            frontier.swap(next);
         }
+    }
 
-        // Extract the {...} part
-        {
-            const std::regex r_brace(R"brace(\{([^}]*)\})brace");
-            std::match_results<std::string_view::const_iterator> m;
+    size_t button_count() const { return buttons.size(); }
 
-            const auto found =
-                std::regex_search(line.begin(), line.end(), m, r_brace);
-            assert(found);
+    /// Rough size of the part 1 search: the GF(2) null space, or half the
+    /// buttons once meet-in-the-middle is cheaper.
+    double light_cost() const {
+        const auto n = buttons.size();
+        const auto free = n - std::min<size_t>(n, lights);
 
-            auto sub = m[1];
-            std::string inside(sub.first, sub.second);
+        return (double)n * lights + std::ldexp(1.0, std::min(free, n / 2));
+    }
 
-            std::stringstream ss(inside);
-            std::string token;
-            while (std::getline(ss, token, ',')) {
-                result.joltage.push_back(std::stoi(token));
-            }
+    /// Rough size of the part 2 search: every free variable ranges over at
+    /// most the largest joltage target. Without counters there is nothing
+    /// to search.
+    double joltage_cost() const {
+        if (joltage.empty()) {
+            return 0;
         }
 
-        return result;
+        const auto n = buttons.size();
+        const auto free = n - std::min(n, joltage.size());
+        const auto range =
+            1.0 + *std::max_element(joltage.cbegin(), joltage.cend());
+
+        return (double)n * joltage.size() * std::pow(range, free);
     }
 
-    int solve() const {
-        std::vector<int> seen(1 << lights, std::numeric_limits<int>::max());
+    friend class Gf2Solver;
+    template <size_t MaxCols, typename T>
+    friend class Solver;
 
-        seen[0] = 0;
-        std::deque<int> q;
-        q.push_back(0);
+   private:
+    /// Bits `i` with bit `k` of `i` clear, for `k = 0..5`.
+    static constexpr std::array<uint64_t, 6> SWAP_MASKS{
+        0x5555555555555555, 0x3333333333333333, 0x0f0f0f0f0f0f0f0f,
+        0x00ff00ff00ff00ff, 0x0000ffff0000ffff, 0x00000000ffffffff,
+    };
 
-        while (!q.empty()) {
-            const auto cur_state = q.front();
-            q.pop_front();
+    int lights;
+    uint64_t state;
+    std::vector<uint64_t> buttons;
+    std::vector<int> joltage;
+};
 
-            if (cur_state == state) {
-                break;
+/// Part 1 over GF(2): pressing the buttons in `x` lights `state` iff
+/// B x = state, where column `j` of B is button `j`. Gauss-Jordan on 64-bit
+/// words yields one solution and a basis of the null space of B, and the
+/// fewest presses is the minimum weight over that coset. The coset is
+/// walked in Gray-code order; when it is larger than splitting the buttons
+/// in half, a meet-in-the-middle over button subsets is used instead.
+class Gf2Solver {
+   public:
+    int solve(const Machine& machine) {
+        const size_t n = machine.buttons.size();
+        const size_t m = machine.lights;
+
+        // Row per light: one bit per button, then the target bit at `n`
+        words = (n + 1 + 63) / 64;
+        rows.assign(m * words, 0);
+        for (size_t j = 0; j < n; ++j) {
+            for (size_t l = 0; l < m; ++l) {
+                if ((machine.buttons[j] >> l) & 1) {
+                    set(row(l), j);
+                }
             }
+        }
+        for (size_t l = 0; l < m; ++l) {
+            if ((machine.state >> l) & 1) {
+                set(row(l), n);
+            }
+        }
 
-            for (const auto& button : buttons) {
-                const auto to_state = cur_state ^ button;
+        pivot_cols.clear();
+        for (size_t col = 0; col < n && pivot_cols.size() < m; ++col) {
+            const auto rank = pivot_cols.size();
 
-                if (std::numeric_limits<int>::max() == seen[to_state]) {
-                    seen[to_state] = seen[cur_state] + 1;
-                    q.push_back(to_state);
+            auto sel = rank;
+            while (sel < m && !get(row(sel), col)) {
+                ++sel;
+            }
+            if (sel == m) {
+                continue;
+            }
+            std::swap_ranges(row(sel), row(sel) + words, row(rank));
+
+            for (size_t r = 0; r < m; ++r) {
+                if (r != rank && get(row(r), col)) {
+                    for (size_t w = col / 64; w < words; ++w) {
+                        row(r)[w] ^= row(rank)[w];
+                    }
                 }
             }
+            pivot_cols.push_back(col);
+        }
+
+        const auto rank = pivot_cols.size();
+        for (size_t r = rank; r < m; ++r) {
+            assert(!get(row(r), n));
         }
 
-        assert(seen[state] != std::numeric_limits<int>::max());
+        const auto d = n - rank;
+        if (d > (n + 1) / 2) {
+            return meet_in_the_middle(machine);
+        }
 
-        return seen[state];
+        return min_coset_weight(n);
     }
 
-    friend class Solver;
-
    private:
-    int lights;
-    int state;
-    std::vector<int> buttons;
-    std::vector<int> joltage;
-};
+    size_t words = 0;
+    std::vector<uint64_t> rows;
+    std::vector<size_t> pivot_cols;
 
-std::string solve_1(const std::string& input) {
-    const auto rows = split_lines_view(input);
+    uint64_t* row(size_t r) { return rows.data() + r * words; }
 
-    int ans = 0;
-    for (const auto& line : rows) {
-        const auto machine = Machine::parse_machine(line);
+    static bool get(const uint64_t* bits, size_t i) {
+        return (bits[i / 64] >> (i % 64)) & 1;
+    }
 
-        ans += machine.solve();
+    static void set(uint64_t* bits, size_t i) {
+        bits[i / 64] |= uint64_t(1) << (i % 64);
     }
 
-    return std::to_string(ans);
-}
+    static int weight(const std::vector<uint64_t>& bits) {
+        int result = 0;
+        for (const auto w : bits) {
+            result += std::popcount(w);
+        }
 
-/// Gaussian Elimination
-/// Solve a system of equations
-/// (0 or 1) * x1 + (0 or 1) * x2 + (0 or 1) * x3 .. (0 or 1) * xn = a1;
-/// (0 or 1) * x1 + (0 or 1) * x2 + (0 or 1) * x3 .. (0 or 1) * xn = a2;
-/// (0 or 1) * x1 + (0 or 1) * x2 + (0 or 1) * x3 .. (0 or 1) * xn = a3;
-/// ..
-/// (0 or 1) * x1 + (0 or 1) * x2 + (0 or 1) * x3 .. (0 or 1) * xn = am;
-/// x1 + x2 + x3 + .. + x4 -> min
-class Solver {
-   public:
-    int solve(const Machine& machine) {
-        const auto m = machine.joltage.size();
+        return result;
+    }
 
-        std::vector<std::vector<int>> A(m, std::vector<int>());
+    int min_coset_weight(size_t n) {
+        const auto rank = pivot_cols.size();
+        const auto n_words = (n + 63) / 64;
+
+        std::vector<bool> is_pivot(n, false);
+        std::vector<uint64_t> x(n_words, 0);
+        for (size_t r = 0; r < rank; ++r) {
+            is_pivot[pivot_cols[r]] = true;
+            if (get(row(r), n)) {
+                set(x.data(), pivot_cols[r]);
+            }
+        }
 
-        for (size_t b = 0; b < machine.buttons.size(); ++b) {
-            const auto& button = machine.buttons[b];
+        // Setting free column `f` forces every pivot whose row contains it
+        std::vector<std::vector<uint64_t>> basis;
+        for (size_t f = 0; f < n; ++f) {
+            if (is_pivot[f]) {
+                continue;
+            }
+
+            auto& v = basis.emplace_back(n_words, 0);
+            set(v.data(), f);
+            for (size_t r = 0; r < rank; ++r) {
+                if (get(row(r), f)) {
+                    set(v.data(), pivot_cols[r]);
+                }
+            }
+        }
+        assert(basis.size() < 64);
 
-            for (size_t light = 0; light < m; ++light) {
-                A[light].push_back((button & (1 << light)) > 0);
+        auto best = weight(x);
+        for (uint64_t k = 1; k < (uint64_t(1) << basis.size()); ++k) {
+            const auto& v = basis[std::countr_zero(k)];
+            for (size_t w = 0; w < n_words; ++w) {
+                x[w] ^= v[w];
             }
+            best = std::min(best, weight(x));
         }
 
-        return run(A, machine.joltage);
+        return best;
+    }
+
+    static int meet_in_the_middle(const Machine& machine) {
+        const auto& buttons = machine.buttons;
+        const auto half = buttons.size() / 2;
+        assert(buttons.size() - half < 64);
+
+        // Fewest presses among the first half for every reachable pattern
+        std::unordered_map<uint64_t, int> left;
+        uint64_t lights = 0;
+        left[0] = 0;
+        for (uint64_t k = 1; k < (uint64_t(1) << half); ++k) {
+            lights ^= buttons[std::countr_zero(k)];
+            const int presses = std::popcount(k ^ (k >> 1));
+
+            const auto [it, inserted] = left.try_emplace(lights, presses);
+            if (!inserted) {
+                it->second = std::min(it->second, presses);
+            }
+        }
+
+        auto best = std::numeric_limits<int>::max();
+        lights = 0;
+        for (uint64_t k = 0; k < (uint64_t(1) << (buttons.size() - half));
+             ++k) {
+            if (k > 0) {
+                lights ^= buttons[half + std::countr_zero(k)];
+            }
+
+            const auto it = left.find(machine.state ^ lights);
+            if (it != left.cend()) {
+                best =
+                    std::min(best, it->second + std::popcount(k ^ (k >> 1)));
+            }
+        }
+        assert(best != std::numeric_limits<int>::max());
+
+        return best;
+    }
+};
+
+/// Part 2 as an integer program: minimise sum x subject to A x = b, x >= 0,
+/// where column `j` of A is button `j` over the joltage counters.
+/// Fraction-free Gauss-Jordan (Bareiss) keeps the reduced system exact:
+/// every pivot row reads D x_p + sum_f M[r][f] x_f = M[r][n] for one
+/// common D. The free variables are then searched by branch and bound: each
+/// value range is narrowed by what the pivot rows still allow, and a branch
+/// is cut once it cannot press fewer buttons than the best solution so far.
+/// The system lives in a `Matrix` of at most `MaxCols` columns, so machines
+/// need fewer than `MaxCols` buttons; `MaxCols == 0` sizes the rows to the
+/// machine instead. Minors of A grow quickly with the number of counters,
+/// so arithmetic in a built-in `T` is checked, and a machine that outgrows
+/// it has no answer here; `BigInt` always has one.
+template <size_t MaxCols, typename T = long long>
+class Solver {
+   public:
+    std::optional<int> solve(const Machine& machine) {
+        m = machine.joltage.size();
+        n = machine.buttons.size();
+        assert(MaxCols == 0 || n < MaxCols);
+        if (m == 0) {
+            return 0;
+        }
+
+        overflow = false;
+        load(machine);
+        eliminate();
+        if (!overflow) {
+            prepare_search(machine);
+        }
+        if (overflow) {
+            return std::nullopt;
+        }
+
+        // No solution presses more than every button to its upper bound
+        T most = 1;
+        for (const auto& u : upper) {
+            most = add(most, u);
+        }
+        const auto none = best = mul(D, most);
+        search(0, objective_base);
+        if (overflow) {
+            return std::nullopt;
+        }
+        assert(best != none);
+
+        return (int)(long long)(best / D);
     }
 
    private:
-    int n, m;
-    std::vector<std::vector<f64>> M;
-    std::vector<int> pivot_col_for_row;
-    std::vector<int> free_vars;
-    std::vector<int> var_to_pivot_row;
-
-    long long best_sum = -1;
-    std::vector<int> best_sol;
-
-    int run(const std::vector<std::vector<int>>& A, const std::vector<int>& b) {
-        m = A.size();
-        n = A[0].size();
-
-        // 1. Build Augmented Matrix [A | b]
-        M.assign(m, std::vector<f64>(n + 1));
-        for (int i = 0; i < m; i++) {
-            for (int j = 0; j < n; j++)
-                M[i][j] = (f64)A[i][j];
-            M[i][n] = (f64)b[i];
-        }
-
-        // 2. Gaussian Elimination to Row Echelon Form
-        int pivot_row = 0;
-        pivot_col_for_row.assign(m, -1);
-        var_to_pivot_row.assign(n, -1);
-
-        for (int col = 0; col < n && pivot_row < m; col++) {
-            // Find pivot in this column
-            int sel = -1;
-            for (int row = pivot_row; row < m; row++) {
-                if (abs(M[row][col]) > EPS) {
-                    sel = row;
-                    break;
+    size_t m = 0, n = 0;
+    Matrix<T, MaxCols> M;
+    std::vector<T> upper;
+    std::vector<size_t> pivot_cols;
+    std::vector<size_t> free_cols;
+    T D = 1;
+    bool overflow = false;
+
+    // Search state. The objective is kept scaled by D: D * sum x
+    std::vector<uint64_t> masks;
+    std::vector<T> residual;
+    std::vector<T> left;
+    std::vector<T> gain;
+    std::vector<T> rest_lo, rest_hi, gain_lo;
+    std::vector<T> pivot_cap;
+    std::vector<int> widest;
+    T pressed = 0;
+    T objective_base = 0;
+    T best = 0;
+
+    static T floor_div(T a, T b) {
+        return a / b - ((a % b != 0) && ((a < 0) != (b < 0)));
+    }
+
+    static T ceil_div(T a, T b) { return -floor_div(-a, b); }
+
+    T add(const T& a, const T& b) {
+        T r;
+        overflow |= add_overflow(a, b, &r);
+
+        return r;
+    }
+
+    T sub(const T& a, const T& b) {
+        T r;
+        overflow |= sub_overflow(a, b, &r);
+
+        return r;
+    }
+
+    T mul(const T& a, const T& b) {
+        T r;
+        overflow |= mul_overflow(a, b, &r);
+
+        return r;
+    }
+
+    void load(const Machine& machine) {
+        M.assign(m, n + 1);
+        upper.assign(n, 0);
+        for (size_t j = 0; j < n; ++j) {
+            // Every button feeds counters of the `{}` group only
+            assert(m >= 64 || (machine.buttons[j] >> m) == 0);
+
+            auto cap = std::numeric_limits<long long>::max();
+            for (size_t l = 0; l < m; ++l) {
+                if ((machine.buttons[j] >> l) & 1) {
+                    M(l, j) = 1;
+                    cap = std::min<long long>(cap, machine.joltage[l]);
                 }
             }
 
-            if (sel == -1) {
-                // No pivot in this column, it's a free variable
+            // A button feeding no counter is never worth pressing
+            upper[j] = cap == std::numeric_limits<long long>::max() ? 0 : cap;
+        }
+        for (size_t l = 0; l < m; ++l) {
+            M(l, n) = machine.joltage[l];
+        }
+    }
+
+    void eliminate() {
+        pivot_cols.clear();
+
+        T prev = 1;
+        for (size_t col = 0; col < n && pivot_cols.size() < m; ++col) {
+            const auto rank = pivot_cols.size();
+
+            auto sel = rank;
+            while (sel < m && M(sel, col) == 0) {
+                ++sel;
+            }
+            if (sel == m) {
                 continue;
             }
+            M.swap_rows(sel, rank);
 
-            // Swap rows
-            swap(M[pivot_row], M[sel]);
+            // Every entry stays a minor of A, so the division is exact
+            const auto pivot = M(rank, col);
+            for (size_t r = 0; r < m; ++r) {
+                if (r == rank) {
+                    continue;
+                }
 
-            // Normalize pivot row
-            f64 div = M[pivot_row][col];
-            for (int j = col; j <= n; j++)
-                M[pivot_row][j] /= div;
+                if (!M.combine(r, pivot, M(r, col), rank)) {
+                    overflow = true;
 
-            // Eliminate other rows
-            for (int i = 0; i < m; i++) {
-                if (i != pivot_row && abs(M[i][col]) > EPS) {
-                    f64 fac = M[i][col];
-                    for (int j = col; j <= n; j++)
-                        M[i][j] -= fac * M[pivot_row][j];
+                    return;
+                }
+                if (prev != 1) {
+                    M.divide_row(r, prev);
                 }
             }
 
-            // Record pivot info
-            pivot_col_for_row[pivot_row] = col;
-            var_to_pivot_row[col] = pivot_row;
-            pivot_row++;
+            prev = pivot;
+            pivot_cols.push_back(col);
         }
 
-        // 3. Check for Inconsistency (0 = 1)
-        for (int i = pivot_row; i < m; i++) {
-            if (abs(M[i][n]) > EPS) {
-                assert(false);
-            }
+        const auto rank = pivot_cols.size();
+        for (size_t r = rank; r < m; ++r) {
+            assert(M(r, n) == 0);
         }
 
-        // 4. Identify Free Variables
-        for (int j = 0; j < n; j++) {
-            if (var_to_pivot_row[j] == -1) {
-                free_vars.push_back(j);
+        D = prev;
+        if (D < 0) {
+            D = -D;
+            for (size_t r = 0; r < rank; ++r) {
+                M.negate_row(r);
             }
         }
+    }
 
-        // 5. Search on Free Variables
-        // If system is fully determined, free_vars is empty, loop runs once.
-        std::vector<int> current_x(n, 0);
-        solve_free(0, current_x);
+    void prepare_search(const Machine& machine) {
+        const auto rank = pivot_cols.size();
 
-        // 6. Output
-        if (best_sum == -1) {
-            assert(false);
+        std::vector<bool> is_pivot(n, false);
+        for (const auto col : pivot_cols) {
+            is_pivot[col] = true;
         }
 
-        // Verification
-        bool all_ok = true;
-        for (int i = 0; i < m; i++) {
-            long long calc = 0;
-            for (int j = 0; j < n; j++) {
-                calc += (long long)A[i][j] * best_sol[j];
+        // D * sum x = sum_r M[r][n] + sum_f (D - sum_r M[r][f]) x_f, so the
+        // free variables that save the most presses are tried first
+        free_cols.clear();
+        std::vector<T> col_gain(n, D);
+        for (size_t j = 0; j < n; ++j) {
+            if (is_pivot[j]) {
+                continue;
             }
-            if (calc != b[i]) {
-                all_ok = false;
+
+            free_cols.push_back(j);
+            for (size_t r = 0; r < rank; ++r) {
+                col_gain[j] = sub(col_gain[j], M(r, j));
             }
         }
-        if (!all_ok) {
-            assert(false);
+        std::sort(free_cols.begin(), free_cols.end(), [&](size_t a, size_t b) {
+            return std::pair{col_gain[a], upper[a]} <
+                   std::pair{col_gain[b], upper[b]};
+        });
+
+        const auto k_free = free_cols.size();
+        gain.resize(k_free);
+        masks.resize(k_free);
+        for (size_t k = 0; k < k_free; ++k) {
+            gain[k] = col_gain[free_cols[k]];
+            masks[k] = machine.buttons[free_cols[k]];
         }
 
-        return best_sum;
+        residual.resize(rank);
+        pivot_cap.resize(rank);
+        objective_base = 0;
+        for (size_t r = 0; r < rank; ++r) {
+            residual[r] = M(r, n);
+            pivot_cap[r] = mul(D, upper[pivot_cols[r]]);
+            objective_base = add(objective_base, M(r, n));
+        }
+        left.assign(machine.joltage.cbegin(), machine.joltage.cend());
+        pressed = 0;
+
+        // What the free variables from `k` on can still take away from
+        // every pivot row, add to the objective at least, and the most
+        // counters one of the remaining buttons feeds
+        rest_lo.assign((k_free + 1) * rank, 0);
+        rest_hi.assign((k_free + 1) * rank, 0);
+        gain_lo.assign(k_free + 1, 0);
+        widest.assign(k_free + 1, 1);
+        for (const auto col : pivot_cols) {
+            widest[k_free] =
+                std::max(widest[k_free], std::popcount(machine.buttons[col]));
+        }
+        for (size_t k = k_free; k-- > 0;) {
+            const auto f = free_cols[k];
+            for (size_t r = 0; r < rank; ++r) {
+                const auto span = mul(M(r, f), upper[f]);
+                rest_lo[k * rank + r] =
+                    add(rest_lo[(k + 1) * rank + r], std::min(T(0), span));
+                rest_hi[k * rank + r] =
+                    add(rest_hi[(k + 1) * rank + r], std::max(T(0), span));
+            }
+            gain_lo[k] =
+                add(gain_lo[k + 1], std::min(T(0), mul(gain[k], upper[f])));
+            widest[k] = std::max(widest[k + 1], std::popcount(masks[k]));
+        }
     }
 
-    void solve_free(size_t idx, std::vector<int>& x) {
-        // Base Case: All free variables assigned
-        if (idx == free_vars.size()) {
-            // Compute Pivot Variables based on Free Variables
-            // Row equation: x_pivot + sum(coeff * x_free) = RHS
-            // x_pivot = RHS - sum(coeff * x_free)
+    /// Fewest presses, scaled by D, any completion of the current branch
+    /// needs: the remaining buttons must still deliver `left` exactly.
+    T lower_bound(size_t k, T objective) {
+        T most = 0, total = 0;
+        for (const auto& v : left) {
+            most = std::max(most, v);
+            total += v;
+        }
+        const auto presses = std::max(most, ceil_div(total, widest[k]));
 
-            long long current_total = 0;
-            std::vector<int> candidate_x = x;
+        return std::max(add(objective, gain_lo[k]),
+                        mul(D, pressed + presses));
+    }
 
-            // Calculate Pivots in reverse order (bottom-up) usually helps,
-            // but since we diagonalized (Jordan), we can do any order.
-            for (int j = 0; j < n; j++) {
-                int r = var_to_pivot_row[j];
-                if (r != -1) {
-                    f64 val = M[r][n];
-                    for (int k = 0; k < n; k++) {
-                        if (k != j && abs(M[r][k]) > EPS) {
-                            val -= M[r][k] * candidate_x[k];
-                        }
-                    }
+    void shift(size_t k, T by) {
+        const auto f = free_cols[k];
+        for (size_t r = 0; r < residual.size(); ++r) {
+            residual[r] = sub(residual[r], mul(M(r, f), by));
+        }
+        for (auto bits = masks[k]; bits != 0; bits &= bits - 1) {
+            left[std::countr_zero(bits)] -= by;
+        }
+        pressed += by;
+    }
 
-                    // Check Integer Integrality
-                    if (val < -EPS || abs(val - round(val)) > EPS) {
-                        // Negative or Non-Integer
-                        return;
-                    }
-                    candidate_x[j] = (int)round(val);
+    void search(size_t k, T objective) {
+        if (overflow || lower_bound(k, objective) >= best) {
+            return;
+        }
+
+        const auto rank = pivot_cols.size();
+        if (k == free_cols.size()) {
+            for (size_t r = 0; r < rank; ++r) {
+                if (residual[r] < 0 || residual[r] > pivot_cap[r] ||
+                    residual[r] % D != 0) {
+                    return;
                 }
-                current_total += candidate_x[j];
             }
+            best = objective;
 
-            // Update Best Solution
-            if (best_sum == -1 || current_total < best_sum) {
-                best_sum = current_total;
-                best_sol = candidate_x;
+            return;
+        }
+
+        // Values of x_f that leave every pivot row within its range
+        const auto f = free_cols[k];
+        T lo = 0, hi = upper[f];
+        for (size_t r = 0; r < rank && lo <= hi; ++r) {
+            const auto a = M(r, f);
+            if (a == 0) {
+                continue;
+            }
+
+            const auto most = sub(residual[r], rest_lo[(k + 1) * rank + r]);
+            const auto least =
+                sub(sub(residual[r], rest_hi[(k + 1) * rank + r]),
+                    pivot_cap[r]);
+            if (a > 0) {
+                lo = std::max(lo, ceil_div(least, a));
+                hi = std::min(hi, floor_div(most, a));
+            } else {
+                lo = std::max(lo, ceil_div(most, a));
+                hi = std::min(hi, floor_div(least, a));
             }
+        }
+        if (lo > hi) {
             return;
         }
 
-        // Recursive Step for Free Variables
-        // We need to bound the free variable.
-        // Heuristic limit: free vars are usually small in minimal sums.
-        // For strictly determined systems, this loop doesn't matter.
-        // For under-determined, we try a reasonable range.
-        // Since input b_i <= 228, variables won't likely exceed ~230.
-        int f_var = free_vars[idx];
+        // Walk the values in the direction that grows the objective, so
+        // the first value that cannot beat `best` ends the loop
+        const T step = gain[k] >= 0 ? 1 : -1;
+        auto value = gain[k] >= 0 ? lo : hi;
+
+        shift(k, value);
+        objective = add(objective, mul(gain[k], value));
+        for (; lo <= value && value <= hi; value += step) {
+            if (add(objective, gain_lo[k + 1]) >= best) {
+                break;
+            }
+            search(k + 1, objective);
 
-        // Optimize: Check if this free var is bounded by any row directly?
-        // Simple 0..230 search is safe given the constraints and speed of
-        // modern CPU if number of free vars is small.
-        for (int val = 0; val <= 250; val++) {
-            x[f_var] = val;
-            solve_free(idx + 1, x);
-            // Optimization: If we found a valid solution, and since we iterate
-            // upwards, later values usually increase sum. (Not strictly true
-            // with negative relationships, but often true). For rigorous
-            // correctness, we don't break early.
+            shift(k, step);
+            objective = add(objective, mul(gain[k], step));
         }
+        shift(k, -value);
     }
 };
 
-std::string solve_2(const std::string& input) {
+/// Part 2 in `long long`, solved again in `__int128` and then in `BigInt`
+/// while the Bareiss minors or the search bounds of a machine outgrow the
+/// narrower type.
+template <size_t MaxCols>
+class JoltageSolver {
+   public:
+    int solve(const Machine& machine) {
+        if (const auto presses = narrow.solve(machine)) {
+            return *presses;
+        }
+        if (const auto presses = wide.solve(machine)) {
+            return *presses;
+        }
+
+        return big.solve(machine).value();
+    }
+
+   private:
+    Solver<MaxCols, long long> narrow;
+    Solver<MaxCols, __int128> wide;
+    Solver<MaxCols, BigInt> big;
+};
+
+std::vector<Machine> parse_machines(const std::string& input) {
     const auto rows = split_lines_view(input);
 
-    int ans = 0;
-    for (const auto& line : rows) {
-        const auto machine = Machine::parse_machine(line);
+    std::vector<Machine> machines(rows.size());
+    for (size_t i = 0; i < rows.size(); ++i) {
+        Machine::parse_machine(rows[i], machines[i]);
+    }
+
+    return machines;
+}
 
-        Solver solver;
-        ans += solver.solve(machine);
+/// Sum of `S().solve(machine)` over all `machines`. Machines are handed out
+/// heaviest first by `cost` from a shared cursor, so one hard machine does
+/// not start last, and every thread keeps a single `S` whose scratch
+/// buffers are reused across its machines.
+template <typename S>
+long long solve_machines(const std::vector<Machine>& machines,
+                         double (Machine::*cost)() const) {
+    std::vector<std::pair<double, size_t>> order;
+    for (size_t i = 0; i < machines.size(); ++i) {
+        order.push_back({-(machines[i].*cost)(), i});
     }
+    std::sort(order.begin(), order.end());
+
+    constexpr size_t MIN_MACHINES_PER_THREAD = 16;
 
-    return std::to_string(ans);
+    std::atomic<size_t> next = 0;
+    std::atomic<long long> total = 0;
+    const auto worker = [&](size_t) {
+        S solver;
+        long long local = 0;
+        for (auto k = next++; k < order.size(); k = next++) {
+            local += solver.solve(machines[order[k].second]);
+        }
+        total += local;
+    };
+
+    run_workers(worker_count(machines.size(), MIN_MACHINES_PER_THREAD),
+                worker);
+
+    return total;
+}
+
+std::string solve_1(const std::string& input) {
+    return std::to_string(solve_machines<Gf2Solver>(parse_machines(input),
+                                                    &Machine::light_cost));
+}
+
+std::string solve_2(const std::string& input) {
+    const auto machines = parse_machines(input);
+
+    size_t buttons = 0;
+    for (const auto& machine : machines) {
+        buttons = std::max(buttons, machine.button_count());
+    }
+
+    // Narrow rows unless some machine needs the wide ones, and rows sized
+    // at run time past the widest fixed ones
+    const auto cost = &Machine::joltage_cost;
+    if (buttons < 16) {
+        return std::to_string(
+            solve_machines<JoltageSolver<16>>(machines, cost));
+    }
+    if (buttons < 64) {
+        return std::to_string(
+            solve_machines<JoltageSolver<64>>(machines, cost));
+    }
+
+    return std::to_string(solve_machines<JoltageSolver<0>>(machines, cost));
 }
 
 int run_tests() {
@@ -348,9 +764,96 @@ int run_tests() {
     assert(solve_1(readFile(day_path("day10", "in_small.txt"))) == "7");
     assert(solve_1(readFile(day_path("day10", "in.txt"))) == "411");
 
+    {
+        // The breadth-first search agrees with the GF(2) solver
+        const auto input = readFile(day_path("day10", "in.txt"));
+
+        int presses = 0;
+        for (const auto& line : split_lines_view(input)) {
+            presses += Machine::parse_machine(line).solve();
+        }
+        assert(presses == 411);
+
+        const auto wide = Machine::parse_machine(
+            "[#.#.#.#.#.#.#.#.#.#.] (0,1) (1,2) (2,3) (3,4) (4,5) (5,6) (6,7) "
+            "(7,8) (8,9) (9,10) (10,11) (11,12) (12,13) (13,14) (14,15) "
+            "(15,16) (16,17) (17,18) (18,19) {0}");
+        assert(wide.solve() == 10);
+    }
+
+    {
+        // Spaces inside groups, and lines cut off in the middle of one
+        const std::string spaced =
+            "[.##.] (3) (1, 3) (2) (2, 3) (0, 2) (0, 1) {3, 5, 4, 7}";
+        assert(solve_1(spaced) == "2");
+        assert(solve_2(spaced) == "10");
+
+        assert(Machine::parse_machine("[.##.] (3) (1,3").button_count() == 2);
+        assert(Machine::parse_machine("[.##.] (3) (1,").button_count() == 2);
+        assert(Machine::parse_machine("[.##").button_count() == 0);
+        assert(solve_2("[.##.] (3) (1,3)\n[.#] (1) {0,2}") == "2");
+    }
+
+    {
+        // 48 lights in a chain: far beyond a BFS over light states
+        std::string chain = "[#" + std::string(46, '.') + "#]";
+        for (int i = 0; i + 1 < 48; ++i) {
+            chain += " (" + to_string(i) + "," + to_string(i + 1) + ")";
+        }
+        chain += " {0}";
+        assert(solve_1(chain) == "47");
+
+        chain += "\n[" + std::string(64, '#') + "]";
+        for (int i = 0; i < 64; ++i) {
+            chain += " (" + to_string(i) + ")";
+        }
+        chain += " (0";
+        for (int i = 1; i < 64; ++i) {
+            chain += "," + to_string(i);
+        }
+        chain += ") {0}";
+        assert(solve_1(chain) == "48");
+    }
+
     assert(solve_2(readFile(day_path("day10", "in_small.txt"))) == "33");
     assert(solve_2(readFile(day_path("day10", "in.txt"))) == "16063");
 
+    {
+        // Six free variables with large targets: exact branch and bound
+        std::string wide = "[......]";
+        for (int i = 0; i < 6; ++i) {
+            wide += " (" + to_string(i) + ")";
+        }
+        for (int i = 0; i + 1 < 6; ++i) {
+            wide += " (" + to_string(i) + "," + to_string(i + 1) + ")";
+        }
+        wide += " (0,1,2,3,4,5) {250,250,250,250,250,250}";
+        assert(solve_2(wide) == "250");
+    }
+
+    {
+        // More buttons than the widest fixed rows hold
+        std::string many = "[..]";
+        for (int i = 0; i < 64; ++i) {
+            many += " (0,1)";
+        }
+        many += " (0) {3,3}";
+        assert(solve_2(many) == "3");
+        assert(solve_2(many + "\n[.#] (1) {0,2}") == "5");
+    }
+
+    {
+        // 39 to 59 counters: the minors outgrow `long long`, and those of
+        // the second machine outgrow `__int128` as well
+        const auto input = readFile(day_path("day10", "in_wide.txt"));
+        assert(solve_2(input) == "192");
+
+        const auto machines = parse_machines(input);
+        assert(Solver<64>().solve(machines[0]) == std::nullopt);
+        assert((Solver<64, __int128>().solve(machines[1]) == std::nullopt));
+        assert((Solver<64, BigInt>().solve(machines[1]) == 42));
+    }
+
     cerr << "All tests passed\n";
 
     return 0;
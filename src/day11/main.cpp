@@ -1,115 +1,885 @@
 #include <aux.hpp>
 
-template <size_t const N>
-std::array<long long, 1 << N> dfs(
-    int p,
-    size_t cur,
-    size_t target,
-    const std::array<size_t, N>& required,
-    const std::vector<std::vector<size_t>>& connections,
-    std::vector<std::optional<std::array<long long, 1 << N>>>& mem) {
-    using state = std::array<long long, 1 << N>;
+/// Device graph in compressed sparse row form: the outputs of node `u` are
+/// `targets[offsets[u] .. offsets[u + 1])`. Three-letter lowercase names
+/// are numbered through a dense 26^3 table; any other name goes through a
+/// hash map of views into the input.
+class Graph {
+   public:
+    /// Two passes over the lines `from: to to ..`: the first numbers the
+    /// names and counts the outputs of every node, the second writes them
+    /// straight into their final slots.
+    static Graph parse(std::string_view input) {
+        Graph graph;
+        graph.dense.assign(DENSE_SIZE, NONE);
 
-    if (cur == target) {
-        auto ans = state{0};
-        ans[0] = 1;
+        std::vector<uint32_t> degree;
+        for_each_edge(input, [&](std::string_view from, std::string_view to) {
+            const auto u = graph.intern(from);
+            graph.intern(to);
 
-        return ans;
+            degree.resize(graph.nodes, 0);
+            ++degree[u];
+        });
+        degree.resize(graph.nodes, 0);
+
+        graph.offsets.assign(graph.nodes + 1, 0);
+        std::partial_sum(degree.cbegin(), degree.cend(),
+                         graph.offsets.begin() + 1);
+
+        graph.targets.resize(graph.offsets.back());
+        auto fill = graph.offsets;
+        for_each_edge(input, [&](std::string_view from, std::string_view to) {
+            graph.targets[fill[*graph.find(from)]++] = *graph.find(to);
+        });
+
+        return graph;
+    }
+
+    /// Unnamed graph with the outputs of node `u` in `adjacency[u]`.
+    static Graph from_adjacency(
+        const std::vector<std::vector<uint32_t>>& adjacency) {
+        Graph graph;
+        graph.nodes = adjacency.size();
+        for (const auto& outputs : adjacency) {
+            graph.targets.insert(graph.targets.end(), outputs.cbegin(),
+                                 outputs.cend());
+            graph.offsets.push_back(graph.targets.size());
+        }
+
+        return graph;
+    }
+
+    /// Unnamed graph with every edge turned around, so that the outputs of
+    /// `u` are its inputs here.
+    Graph reversed() const {
+        Graph graph;
+        graph.nodes = nodes;
+        graph.offsets.assign(nodes + 1, 0);
+        for (const auto v : targets) {
+            ++graph.offsets[v + 1];
+        }
+        std::partial_sum(graph.offsets.cbegin(), graph.offsets.cend(),
+                         graph.offsets.begin());
+
+        graph.targets.resize(targets.size());
+        auto fill = graph.offsets;
+        for (uint32_t u = 0; u < nodes; ++u) {
+            for (const auto v : outputs(u)) {
+                graph.targets[fill[v]++] = u;
+            }
+        }
+
+        return graph;
+    }
+
+    size_t size() const { return nodes; }
+
+    std::span<const uint32_t> outputs(uint32_t u) const {
+        return {targets.data() + offsets[u], targets.data() + offsets[u + 1]};
+    }
+
+    std::optional<uint32_t> find(std::string_view name) const {
+        if (const auto key = dense_key(name); key != NONE) {
+            if (dense.empty() || dense[key] == NONE) {
+                return std::nullopt;
+            }
+
+            return dense[key];
+        }
+
+        const auto it = others.find(name);
+        if (it == others.cend()) {
+            return std::nullopt;
+        }
+
+        return it->second;
+    }
+
+   private:
+    static constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+    static constexpr size_t DENSE_SIZE = 26 * 26 * 26;
+
+    static uint32_t dense_key(std::string_view name) {
+        if (name.size() != 3) {
+            return NONE;
+        }
+
+        uint32_t key = 0;
+        for (const auto c : name) {
+            if (c < 'a' || c > 'z') {
+                return NONE;
+            }
+            key = key * 26 + (c - 'a');
+        }
+
+        return key;
+    }
+
+    template <typename F>
+    static void for_each_edge(std::string_view input, F visit) {
+        for (size_t at = 0; at < input.size();) {
+            const auto end = std::min(input.find('\n', at), input.size());
+            const auto line = input.substr(at, end - at);
+            at = end + 1;
+
+            const auto colon = line.find(':');
+            if (colon == std::string_view::npos) {
+                continue;
+            }
+
+            const auto from = line.substr(0, colon);
+            for (size_t i = colon + 1; i < line.size();) {
+                if (line[i] == ' ' || line[i] == '\r') {
+                    ++i;
+
+                    continue;
+                }
+
+                auto j = i;
+                while (j < line.size() && line[j] != ' ' && line[j] != '\r') {
+                    ++j;
+                }
+                visit(from, line.substr(i, j - i));
+                i = j;
+            }
+        }
+    }
+
+    uint32_t intern(std::string_view name) {
+        if (const auto key = dense_key(name); key != NONE) {
+            if (dense[key] == NONE) {
+                dense[key] = nodes++;
+            }
+
+            return dense[key];
+        }
+
+        const auto [it, inserted] = others.try_emplace(name, nodes);
+        nodes += inserted;
+
+        return it->second;
+    }
+
+    uint32_t nodes = 0;
+    std::vector<uint32_t> dense;
+    std::unordered_map<std::string_view, uint32_t> others;
+    std::vector<uint32_t> offsets{0};
+    std::vector<uint32_t> targets;
+};
+
+/// Strongly connected components by an iterative Tarjan, and the graph
+/// condensed to one node per component. Components are numbered in
+/// topological order of the condensation, and edges inside a component are
+/// dropped while parallel edges between components are kept, so path
+/// counts that avoid cycles are the same on both graphs. Outputs of
+/// `target`, where counting stops, are dropped first: a path never
+/// continues through it, so cycles that close there are no loops.
+class Condensation {
+   public:
+    explicit Condensation(const Graph& graph,
+                          std::optional<uint32_t> target = std::nullopt)
+        : component(graph.size(), NONE) {
+        const auto outputs_of = [&](uint32_t u) {
+            return u == target ? std::span<const uint32_t>{} : graph.outputs(u);
+        };
+
+        const auto n = graph.size();
+
+        std::vector<uint32_t> index(n, NONE), low(n, 0);
+        std::vector<uint32_t> stack;
+        std::vector<std::pair<uint32_t, uint32_t>> frames;
+        uint32_t next_index = 0;
+        uint32_t components = 0;
+
+        for (uint32_t root = 0; root < n; ++root) {
+            if (index[root] != NONE) {
+                continue;
+            }
+
+            index[root] = low[root] = next_index++;
+            stack.push_back(root);
+            frames.push_back({root, 0});
+            while (!frames.empty()) {
+                auto& [u, edge] = frames.back();
+                const auto outputs = outputs_of(u);
+
+                if (edge < outputs.size()) {
+                    const auto v = outputs[edge++];
+                    if (index[v] == NONE) {
+                        index[v] = low[v] = next_index++;
+                        stack.push_back(v);
+                        frames.push_back({v, 0});
+                    } else if (component[v] == NONE) {
+                        // Still on the stack
+                        low[u] = std::min(low[u], index[v]);
+                    }
+
+                    continue;
+                }
+
+                const auto done = u;
+                frames.pop_back();
+                if (!frames.empty()) {
+                    auto& parent = frames.back().first;
+                    low[parent] = std::min(low[parent], low[done]);
+                }
+
+                if (low[done] == index[done]) {
+                    uint32_t size = 0;
+                    uint32_t w;
+                    do {
+                        w = stack.back();
+                        stack.pop_back();
+                        component[w] = components;
+                        ++size;
+                    } while (w != done);
+                    cyclic.push_back(size > 1);
+                    ++components;
+                }
+            }
+        }
+
+        // Tarjan closes the sinks first, so reverse the numbering
+        for (auto& c : component) {
+            c = components - 1 - c;
+        }
+        std::reverse(cyclic.begin(), cyclic.end());
+
+        std::vector<std::vector<uint32_t>> edges(components);
+        for (uint32_t u = 0; u < n; ++u) {
+            for (const auto v : outputs_of(u)) {
+                if (component[u] != component[v]) {
+                    edges[component[u]].push_back(component[v]);
+                } else if (u == v) {
+                    cyclic[component[u]] = true;
+                }
+            }
+        }
+        dag = Graph::from_adjacency(edges);
+        for (const auto is_cyclic : cyclic) {
+            any_cycle |= is_cyclic;
+        }
+
+        reach.assign(components, false);
+        coreach.assign(components, false);
+    }
+
+    Condensation(const Condensation&) = delete;
+    Condensation& operator=(const Condensation&) = delete;
+
+    const Graph& graph() const { return dag; }
+
+    /// Component of `u`, or the size of the condensation for nodes outside
+    /// the graph.
+    uint32_t of(uint32_t u) const {
+        return u < component.size() ? component[u] : dag.size();
+    }
+
+    bool has_cycles() const { return any_cycle; }
+
+    bool is_cyclic(uint32_t c) const { return c < cyclic.size() && cyclic[c]; }
+
+    /// Whether some walk from `start` to `target` through all `required`
+    /// components runs through a cyclic one, so that it can loop there
+    /// forever. Segments between consecutive stops cover disjoint ranges
+    /// of components, so a query is linear in the condensation.
+    bool unbounded(uint32_t start,
+                   uint32_t target,
+                   std::span<const uint32_t> required) {
+        std::vector<uint32_t> stops(required.begin(), required.end());
+        std::sort(stops.begin(), stops.end());
+        stops.erase(std::unique(stops.begin(), stops.end()), stops.end());
+        stops.push_back(target);
+
+        bool looped = false;
+        auto from = start;
+        for (const auto stop : stops) {
+            if (stop >= dag.size() || from > stop) {
+                return false;
+            }
+
+            for (auto c = from; c <= stop; ++c) {
+                reach[c] = c == from;
+                coreach[c] = c == stop;
+            }
+            for (auto c = from; c < stop; ++c) {
+                for (const auto d : dag.outputs(c)) {
+                    if (d <= stop) {
+                        reach[d] = reach[d] || reach[c];
+                    }
+                }
+            }
+            for (auto c = stop; c-- > from;) {
+                for (const auto d : dag.outputs(c)) {
+                    if (d <= stop) {
+                        coreach[c] = coreach[c] || coreach[d];
+                    }
+                }
+            }
+            if (!reach[stop]) {
+                return false;
+            }
+
+            for (auto c = from; c <= stop; ++c) {
+                looped |= cyclic[c] && reach[c] && coreach[c];
+            }
+            from = stop;
+        }
+
+        return looped;
     }
-    if (const auto cur_mem = mem[cur]; cur_mem) {
-        return *cur_mem;
+
+   private:
+    static constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+    std::vector<uint32_t> component;
+    std::vector<bool> cyclic;
+    bool any_cycle = false;
+    Graph dag;
+
+    std::vector<bool> reach, coreach;
+};
+
+/// Kahn's algorithm: every node comes after all of its inputs.
+std::vector<uint32_t> topological_order(const Graph& graph) {
+    const auto n = graph.size();
+
+    std::vector<uint32_t> in_degree(n, 0);
+    for (uint32_t u = 0; u < n; ++u) {
+        for (const auto v : graph.outputs(u)) {
+            ++in_degree[v];
+        }
     }
 
-    size_t cur_required = 0;
+    std::vector<uint32_t> order;
+    order.reserve(n);
+    for (uint32_t u = 0; u < n; ++u) {
+        if (in_degree[u] == 0) {
+            order.push_back(u);
+        }
+    }
+    for (size_t head = 0; head < order.size(); ++head) {
+        for (const auto v : graph.outputs(order[head])) {
+            if (--in_degree[v] == 0) {
+                order.push_back(v);
+            }
+        }
+    }
+    assert(order.size() == n);
+
+    return order;
+}
+
+/// Nodes of a DAG grouped into levels: a node is one level deeper than the
+/// deepest of its inputs, so the nodes of a level only depend on earlier
+/// levels and can be computed side by side. Keeps the reversed graph for
+/// pulling from the inputs.
+class LevelSchedule {
+   public:
+    LevelSchedule(const Graph& graph, const std::vector<uint32_t>& order)
+        : inputs(graph.reversed()), depth(graph.size(), 0) {
+        uint32_t levels = 0;
+        for (const auto u : order) {
+            for (const auto v : graph.outputs(u)) {
+                depth[v] = std::max(depth[v], depth[u] + 1);
+            }
+            levels = std::max(levels, depth[u] + 1);
+        }
+
+        begin.assign(levels + 1, 0);
+        for (const auto d : depth) {
+            ++begin[d + 1];
+        }
+        std::partial_sum(begin.cbegin(), begin.cend(), begin.begin());
+
+        nodes.resize(graph.size());
+        auto fill = begin;
+        for (const auto u : order) {
+            nodes[fill[depth[u]]++] = u;
+        }
+    }
+
+    LevelSchedule(const LevelSchedule&) = delete;
+    LevelSchedule& operator=(const LevelSchedule&) = delete;
+
+    const Graph& reversed() const { return inputs; }
+
+    size_t levels() const { return begin.size() - 1; }
+
+    uint32_t level_of(uint32_t u) const { return depth[u]; }
+
+    std::span<const uint32_t> level(size_t l) const {
+        return {nodes.data() + begin[l], nodes.data() + begin[l + 1]};
+    }
+
+   private:
+    Graph inputs;
+    std::vector<uint32_t> depth;
+    std::vector<uint32_t> begin;
+    std::vector<uint32_t> nodes;
+};
+
+/// Paths from `start` to `target` by the set of `required` nodes they pass,
+/// as a bit mask. Levels are swept in order and every node pulls the counts
+/// of its inputs, so the nodes of a wide level can be split between threads
+/// that all finish before the next level starts. Inputs are summed mask by
+/// mask into a scratch row first, which vectorises, and only then shifted
+/// by the required bit of the node. A path ends at `target` and does not
+/// continue through it. Required nodes outside the graph are never passed.
+template <size_t const N, typename Count = long long>
+std::array<Count, 1 << N> count_paths(const LevelSchedule& schedule,
+                                      uint32_t start,
+                                      uint32_t target,
+                                      const std::array<uint32_t, N>& required) {
+    constexpr size_t S = 1 << N;
+    constexpr size_t MIN_NODES_PER_THREAD = 1 << 14;
+
+    const auto& inputs = schedule.reversed();
+    const auto n = inputs.size();
+
+    std::vector<uint32_t> required_bits(n, 0);
     for (size_t i = 0; i < N; ++i) {
-        if (cur == required[i]) {
-            cur_required |= (1 << i);
+        if (required[i] < n) {
+            required_bits[required[i]] |= 1 << i;
         }
     }
 
-    auto children_ways = state{0};
-    for (const auto to : connections[cur]) {
-        if ((int)to == p) {
+    std::vector<Count> count(n * S, Count(0));
+
+    const auto pull = [&](uint32_t v, std::array<Count, S>& sum) {
+        sum.fill(Count(0));
+        for (const auto u : inputs.outputs(v)) {
+            if (u == target) {
+                continue;
+            }
+
+            const auto* from = &count[u * S];
+            for (size_t mask = 0; mask < S; ++mask) {
+                sum[mask] += from[mask];
+            }
+        }
+        if (v == start) {
+            sum[0] += Count(1);
+        }
+
+        auto* to = &count[v * S];
+        for (size_t mask = 0; mask < S; ++mask) {
+            to[mask | required_bits[v]] += sum[mask];
+        }
+    };
+
+    // Nothing in a level before that of `start` is reachable from it.
+    // Narrow levels stay on this thread, so deep graphs do not pay for a
+    // fan-out per level.
+    std::array<Count, S> sum;
+    for (auto l = schedule.level_of(start); l < schedule.levels(); ++l) {
+        const auto nodes = schedule.level(l);
+        const auto threads = worker_count(nodes.size(), MIN_NODES_PER_THREAD);
+        if (threads == 1) {
+            for (const auto v : nodes) {
+                pull(v, sum);
+            }
+
             continue;
         }
 
+        run_workers(threads, [&](size_t t) {
+            std::array<Count, S> local;
+            const auto end = nodes.size() * (t + 1) / threads;
+            for (auto i = nodes.size() * t / threads; i < end; ++i) {
+                pull(nodes[i], local);
+            }
+        });
+    }
+
+    std::array<Count, S> result;
+    std::copy_n(&count[target * S], S, result.begin());
+
+    return result;
+}
+
+/// Paths from `start` to `target` through every node of a required set of
+/// any size. Up to four required nodes go through the mask table of
+/// `count_paths`. Beyond that the count is factored instead: in a DAG a
+/// path meets its required nodes in topological order, so it is the product
+/// of plain path counts between consecutive ones, and those segments cover
+/// disjoint ranges of the order, keeping a query linear in the graph.
+template <typename Count = long long>
+class PathCounter {
+   public:
+    explicit PathCounter(const Graph& graph)
+        : graph(graph),
+          order(topological_order(graph)),
+          schedule(graph, order),
+          position(graph.size()),
+          ways(graph.size(), Count(0)) {
+        for (size_t i = 0; i < order.size(); ++i) {
+            position[order[i]] = i;
+        }
+    }
+
+    PathCounter(const PathCounter&) = delete;
+    PathCounter& operator=(const PathCounter&) = delete;
+
+    /// Required nodes outside the graph, e.g. `graph.size()`, are never
+    /// passed.
+    Count count(uint32_t start,
+                uint32_t target,
+                std::span<const uint32_t> required) {
+        switch (required.size()) {
+            case 0:
+                return through_masks<0>(start, target, required);
+            case 1:
+                return through_masks<1>(start, target, required);
+            case 2:
+                return through_masks<2>(start, target, required);
+            case 3:
+                return through_masks<3>(start, target, required);
+            case 4:
+                return through_masks<4>(start, target, required);
+            default:
+                return through_segments(start, target, required);
+        }
+    }
+
+   private:
+    template <size_t N>
+    Count through_masks(uint32_t start,
+                        uint32_t target,
+                        std::span<const uint32_t> required) const {
+        std::array<uint32_t, N> fixed;
+        std::copy_n(required.begin(), N, fixed.begin());
+
         const auto ways =
-            dfs<N>((int)cur, to, target, required, connections, mem);
+            count_paths<N, Count>(schedule, start, target, fixed);
 
-        for (size_t i = 0; i < (1 << N); ++i) {
-            children_ways[i] += ways[i];
+        return ways[(1 << N) - 1];
+    }
+
+    Count through_segments(uint32_t start,
+                           uint32_t target,
+                           std::span<const uint32_t> required) {
+        std::vector<uint32_t> stops(required.begin(), required.end());
+        for (const auto node : stops) {
+            if (node >= graph.size()) {
+                return Count(0);
+            }
+        }
+        std::sort(stops.begin(), stops.end(), [&](uint32_t a, uint32_t b) {
+            return position[a] < position[b];
+        });
+        stops.erase(std::unique(stops.begin(), stops.end()), stops.end());
+
+        Count result(1);
+        auto from = start;
+        for (const auto stop : stops) {
+            result *= count_between(from, stop);
+            from = stop;
         }
+
+        return result * count_between(from, target);
     }
 
-    auto cur_ways = state{0};
-    for (size_t i = 0; i < (1 << N); ++i) {
-        cur_ways[i | cur_required] += children_ways[i];
+    /// Plain path count from `from` to `to`, pushing counts forward over the
+    /// order between the two.
+    Count count_between(uint32_t from, uint32_t to) {
+        if (position[from] > position[to]) {
+            return Count(0);
+        }
+
+        const auto begin = position[from];
+        const auto end = position[to];
+        for (auto i = begin; i <= end; ++i) {
+            ways[order[i]] = Count(0);
+        }
+        ways[from] = Count(1);
+
+        for (auto i = begin; i < end; ++i) {
+            const auto u = order[i];
+            for (const auto v : graph.outputs(u)) {
+                if (position[v] <= end) {
+                    ways[v] += ways[u];
+                }
+            }
+        }
+
+        return ways[to];
     }
 
-    mem[cur] = cur_ways;
+    const Graph& graph;
+    std::vector<uint32_t> order;
+    LevelSchedule schedule;
+    std::vector<size_t> position;
+    std::vector<Count> ways;
+};
 
-    return cur_ways;
+template <typename Count = long long>
+std::string show(const std::optional<Count>& ways) {
+    return ways ? count_to_string(*ways) : "infinite";
 }
 
-template <size_t const N>
-std::array<long long, 1 << N> solve(std::array<std::string, N> required_str,
-                                    const std::string& start,
-                                    const std::string& end,
-                                    const std::string& input) {
-    const auto rows = split_lines_view(input);
+/// The `capacity` most recently used values by key. A missing value is
+/// built by `make`, which is handed the evicted one to reuse its buffers.
+template <typename K, typename V>
+class LruCache {
+   public:
+    explicit LruCache(size_t capacity)
+        : capacity(std::max<size_t>(capacity, 1)) {}
 
-    std::map<std::string_view, size_t> indx;
-    auto insert = [&](std::string_view s) {
-        if (indx.cend() == indx.find(s)) {
-            return indx[s] = indx.size();
-        } else {
-            return indx[s];
+    template <typename F>
+    V& get(const K& key, F make) {
+        if (const auto it = entries.find(key); it != entries.end()) {
+            recent.splice(recent.begin(), recent, it->second.second);
+
+            return it->second.first;
         }
-    };
 
-    std::vector<std::vector<size_t>> connections;
+        V spare{};
+        if (entries.size() == capacity) {
+            auto node = entries.extract(recent.back());
+            recent.pop_back();
+            spare = std::move(node.mapped().first);
+        }
 
-    for (const auto line : rows) {
-        const auto split = split_view(line, ": ");
+        recent.push_front(key);
+        const auto it =
+            entries.try_emplace(key, make(std::move(spare)), recent.begin())
+                .first;
 
-        const auto from = insert(split[0]);
+        return it->second.first;
+    }
 
-        while (connections.size() <= from) {
-            connections.push_back({});
+   private:
+    size_t capacity;
+    std::list<K> recent;
+    std::unordered_map<K, std::pair<V, typename std::list<K>::iterator>>
+        entries;
+};
+
+/// Answers many path queries against one graph. A query is factored into
+/// segments as in `PathCounter`, but every segment count is read from a
+/// reverse table of paths into its end node, computed over the whole order
+/// once. The most recently used tables are kept, keyed by their end node.
+/// Tables are built on a condensation; queries that can loop through a
+/// cycle have no count, which the same tables tell per segment start, so a
+/// warm query costs one lookup per stop. Cutting the outputs of a target
+/// that lies on no cycle changes no component, so one condensation of the
+/// whole graph serves all of those; a target on a cycle gets its own,
+/// cached as well.
+template <typename Count = long long>
+class PathServer {
+   public:
+    PathServer(const Graph& graph, size_t capacity)
+        : graph(graph),
+          whole(graph, std::nullopt),
+          views(capacity),
+          tables(capacity) {}
+
+    PathServer(const PathServer&) = delete;
+    PathServer& operator=(const PathServer&) = delete;
+
+    std::optional<Count> count(uint32_t start,
+                               uint32_t target,
+                               std::span<const uint32_t> required) {
+        auto& view = view_for(target);
+        auto& condensed = view.condensed;
+
+        std::vector<uint32_t> stops;
+        for (const auto node : required) {
+            stops.push_back(condensed.of(node));
         }
+        start = condensed.of(start);
+        target = condensed.of(target);
 
-        for (const auto to : split_view(split[1], " ")) {
-            const auto i = insert(to);
+        std::sort(stops.begin(), stops.end(), [&](uint32_t a, uint32_t b) {
+            return view.position[a] < view.position[b];
+        });
+        stops.erase(std::unique(stops.begin(), stops.end()), stops.end());
+        stops.push_back(target);
 
-            connections[from].push_back(i);
-        };
+        // A segment that is never reached leaves no path to loop on
+        Count result(1);
+        bool looped = false;
+        auto from = start;
+        for (const auto stop : stops) {
+            const auto& table = paths_to(view, stop);
+            if (table.reach[from] == UNREACHED) {
+                return Count(0);
+            }
+
+            looped |= table.reach[from] == LOOPED;
+            result *= table.ways[from];
+            from = stop;
+        }
+        if (looped) {
+            return std::nullopt;
+        }
+
+        return result;
     }
 
-    std::vector<std::optional<std::array<long long, 1 << N>>> mem(
-        connections.size(), std::nullopt);
+    /// One query per line, `start end [required ..]`, one count per line.
+    /// Names that are not in the graph give 0, and counts that can loop
+    /// through a cycle give `infinite`.
+    void serve(std::istream& in, std::ostream& out) {
+        std::string line;
+        std::vector<uint32_t> nodes;
+        while (std::getline(in, line)) {
+            nodes.clear();
 
-    std::array<size_t, N> required;
-    for (size_t i = 0; i < N; ++i) {
-        required[i] = indx[required_str[i]];
+            bool known = true;
+            for (const auto name : split_view(line, " ")) {
+                if (name.empty()) {
+                    continue;
+                }
+
+                const auto node = graph.find(name);
+                known &= node.has_value();
+                nodes.push_back(node.value_or(0));
+            }
+            if (nodes.empty()) {
+                continue;
+            }
+            if (nodes.size() < 2) {
+                out << "expected: <start> <end> [required ..]\n";
+
+                continue;
+            }
+
+            const auto required = std::span(nodes).subspan(2);
+            const auto ways =
+                known ? count(nodes[0], nodes[1], required) : Count(0);
+            out << show(ways) << '\n';
+        }
+        out.flush();
     }
 
-    return dfs<N>(-1, indx[start], indx[end], required, connections, mem);
-}
+   private:
+    static constexpr uint32_t WHOLE = std::numeric_limits<uint32_t>::max();
 
-std::string solve_1(const std::string& input) {
-    const size_t N = 0;
+    /// How a component reaches the end node of a table: not at all, only
+    /// along acyclic components, or through some cyclic one.
+    enum Reach : uint8_t { UNREACHED, REACHED, LOOPED };
 
-    const auto ans = solve<N>({}, "you", "out", input);
+    struct Table {
+        std::vector<Count> ways;
+        std::vector<Reach> reach;
+    };
 
-    return std::to_string(ans[(1 << N) - 1]);
-}
+    /// A condensation cut at `key`, or of the whole graph for `WHOLE`, with
+    /// the topological order of its DAG.
+    struct View {
+        View(const Graph& graph, std::optional<uint32_t> target)
+            : key(target.value_or(WHOLE)),
+              condensed(graph, target),
+              order(topological_order(condensed.graph())),
+              position(order.size()) {
+            for (size_t i = 0; i < order.size(); ++i) {
+                position[order[i]] = i;
+            }
+        }
 
-std::string solve_2(const std::string& input) {
-    const size_t N = 2;
+        uint32_t key;
+        Condensation condensed;
+        std::vector<uint32_t> order;
+        std::vector<size_t> position;
+    };
 
-    const auto ans = solve<N>({"dac", "fft"}, "svr", "out", input);
+    View& view_for(uint32_t target) {
+        if (!whole.condensed.is_cyclic(whole.condensed.of(target))) {
+            return whole;
+        }
 
-    return std::to_string(ans[(1 << N) - 1]);
+        return *views.get(target, [&](std::unique_ptr<View>) {
+            return std::make_unique<View>(graph, target);
+        });
+    }
+
+    /// `ways[c]` is the number of paths from `c` to `target` in `view`, and
+    /// `reach[c]` whether one of them runs through a cyclic component.
+    /// Views are rebuilt the same way after eviction, so their tables stay
+    /// valid.
+    const Table& paths_to(const View& view, uint32_t target) {
+        const auto key = (uint64_t)view.key << 32 | target;
+
+        return tables.get(key, [&](Table table) {
+            const auto& condensed = view.condensed;
+            const auto& dag = condensed.graph();
+            table.ways.assign(dag.size(), Count(0));
+            table.reach.assign(dag.size(), UNREACHED);
+
+            const auto close = [&](uint32_t u) {
+                if (table.reach[u] == REACHED && condensed.is_cyclic(u)) {
+                    table.reach[u] = LOOPED;
+                }
+            };
+
+            table.ways[target] = Count(1);
+            table.reach[target] = REACHED;
+            close(target);
+            for (auto i = view.position[target]; i-- > 0;) {
+                const auto u = view.order[i];
+                for (const auto v : dag.outputs(u)) {
+                    table.ways[u] += table.ways[v];
+                    table.reach[u] = std::max(table.reach[u], table.reach[v]);
+                }
+                close(u);
+            }
+
+            return table;
+        });
+    }
+
+    const Graph& graph;
+    View whole;
+    LruCache<uint32_t, std::unique_ptr<View>> views;
+    LruCache<uint64_t, Table> tables;
+};
+
+/// Paths from `start` to `end` through all `required` devices, or nothing
+/// when some of them can loop through a cycle forever.
+template <typename Count = long long>
+std::optional<Count> solve(const std::vector<std::string>& required_str,
+                           const std::string& start,
+                           const std::string& end,
+                           const std::string& input) {
+    const auto graph = Graph::parse(input);
+
+    const auto from = graph.find(start);
+    const auto to = graph.find(end);
+    if (!from || !to) {
+        return Count(0);
+    }
+
+    Condensation condensed(graph, *to);
+
+    std::vector<uint32_t> required;
+    for (const auto& name : required_str) {
+        required.push_back(
+            condensed.of(graph.find(name).value_or(graph.size())));
+    }
+
+    const auto start_c = condensed.of(*from);
+    const auto end_c = condensed.of(*to);
+    if (condensed.has_cycles() &&
+        condensed.unbounded(start_c, end_c, required)) {
+        return std::nullopt;
+    }
+
+    PathCounter<Count> counter(condensed.graph());
+
+    return counter.count(start_c, end_c, required);
+}
+
+template <typename Count = long long>
+std::string solve_1(const std::string& input) {
+    return show(solve<Count>({}, "you", "out", input));
+}
+
+template <typename Count = long long>
+std::string solve_2(const std::string& input) {
+    return show(solve<Count>({"dac", "fft"}, "svr", "out", input));
 }
 
 int run_tests() {
@@ -121,6 +891,212 @@ int run_tests() {
     assert(solve_2(readFile(day_path("day11", "in_small_2.txt"))) == "2");
     assert(solve_2(readFile(day_path("day11", "in.txt"))) == "473930047491888");
 
+    {
+        // Every count type agrees where long long suffices
+        const auto input = readFile(day_path("day11", "in.txt"));
+        assert(solve_2<__int128>(input) == "473930047491888");
+        assert(solve_2<BigUint>(input) == "473930047491888");
+        assert(solve_2<ModInt<1'000'000'007>>(input) == "44174378");
+
+        using Crt = MultiModInt<2'305'843'009'213'693'951,
+                                1'000'000'000'000'000'003,
+                                1'000'000'000'000'000'009>;
+        assert(solve_2<Crt>(input) == "473930047491888");
+    }
+
+    {
+        // 81 fully connected layers of two devices: 2^79 paths through
+        // both required ones, far past 64 bits
+        const auto name = [](size_t layer, size_t k) -> std::string {
+            if (layer == 40 && k == 0) {
+                return "dac";
+            }
+            if (layer == 60 && k == 1) {
+                return "fft";
+            }
+            const auto i = 2 * layer + k;
+
+            return {'x', (char)('a' + i / 26), (char)('a' + i % 26)};
+        };
+
+        std::string layers = "svr: " + name(0, 0) + " " + name(0, 1);
+        for (size_t layer = 0; layer <= 80; ++layer) {
+            for (size_t k = 0; k < 2; ++k) {
+                layers += "\n" + name(layer, k) + ":";
+                if (layer == 80) {
+                    layers += " out";
+                } else {
+                    layers += " " + name(layer + 1, 0);
+                    layers += " " + name(layer + 1, 1);
+                }
+            }
+        }
+
+        const std::string expected = "604462909807314587353088";
+        assert(solve_2<BigUint>(layers) == expected);
+        using Crt = MultiModInt<2'305'843'009'213'693'951,
+                                1'000'000'000'000'000'003>;
+        assert(solve_2<Crt>(layers) == expected);
+        assert(solve_2<__int128>(layers) == expected);
+    }
+
+    {
+        // A chain far deeper than a recursive search would like, with one
+        // shortcut around its second node
+        const auto name = [](size_t i) {
+            return std::string{(char)('a' + i / 676), (char)('a' + i / 26 % 26),
+                               (char)('a' + i % 26)};
+        };
+
+        std::string chain = name(0) + ": " + name(1) + " " + name(2) + "\n";
+        for (size_t i = 1; i + 1 < 17000; ++i) {
+            chain += name(i) + ": " + name(i + 1) + "\n";
+        }
+
+        assert(solve({}, name(0), name(16999), chain) == 2);
+        assert(solve({name(1)}, name(0), name(16999), chain) == 1);
+    }
+
+    {
+        // A deep ladder of narrow levels, swept on the calling thread;
+        // every rung but the two required ones doubles the count
+        constexpr size_t RUNGS = 20000;
+        const auto name = [](size_t rung, size_t k) {
+            if (rung == 100 && k == 0) {
+                return std::string("dac");
+            }
+            if (rung == 15000 && k == 1) {
+                return std::string("fft");
+            }
+
+            return "r" + std::to_string(rung) + "_" + std::to_string(k);
+        };
+
+        std::string ladder = "svr: " + name(0, 0) + " " + name(0, 1);
+        for (size_t rung = 0; rung < RUNGS; ++rung) {
+            for (size_t k = 0; k < 2; ++k) {
+                ladder += "\n" + name(rung, k) + ":";
+                if (rung + 1 == RUNGS) {
+                    ladder += " out";
+                } else {
+                    ladder += " " + name(rung + 1, 0);
+                    ladder += " " + name(rung + 1, 1);
+                }
+            }
+        }
+
+        using Mod = ModInt<1'000'000'007>;
+        Mod expected(1);
+        for (size_t rung = 2; rung < RUNGS; ++rung) {
+            expected += expected;
+        }
+        assert(solve_2<Mod>(ladder) == count_to_string(expected));
+    }
+
+    {
+        // Two levels wide enough to be split between threads, on either
+        // side of `dac`
+        constexpr size_t WIDTH = 40000;
+
+        std::string fan = "svr:";
+        for (size_t i = 0; i < WIDTH; ++i) {
+            fan += " m" + std::to_string(i);
+        }
+        fan += "\ndac:";
+        for (size_t i = 0; i < WIDTH; ++i) {
+            fan += " w" + std::to_string(i);
+        }
+        for (size_t i = 0; i < WIDTH; ++i) {
+            fan += "\nm" + std::to_string(i) + ": dac";
+            fan += "\nw" + std::to_string(i) + ": fft";
+        }
+        fan += "\nfft: out";
+
+        assert(solve_2(fan) == std::to_string(WIDTH * WIDTH));
+    }
+
+    {
+        // Required sets past the mask table factor into segments
+        const auto small = readFile(day_path("day11", "in_small_2.txt"));
+        assert(solve({"fft", "ccc", "eee", "dac", "fff"}, "svr", "out",
+                     small) == 2);
+        assert(solve({"fft", "ccc", "ddd", "dac", "fff"}, "svr", "out",
+                     small) == 0);
+
+        const auto input = readFile(day_path("day11", "in.txt"));
+        assert(solve({"dac", "fft", "dac", "fft", "dac"}, "svr", "out",
+                     input) == 473930047491888);
+    }
+
+    {
+        // Feedback loops only matter on the way to the target
+        const auto small = readFile(day_path("day11", "in_small_2.txt"));
+        assert(solve_2(small + "\nsvr: lpa\nlpa: lpb\nlpb: lpa") == "2");
+        assert(solve_2(small + "\nggg: aaa") == "infinite");
+        assert(solve_2(small + "\ndac: dac") == "infinite");
+        assert(solve_2(small + "\nhub: hub") == "2");
+        assert(!solve({"fft"}, "svr", "out", small + "\nhub: hub"));
+
+        // Nor do loops that only close through the target
+        assert(solve({}, "you", "out", "you: out\nout: you") == 1);
+        assert(solve_2(small + "\nout: svr") == "2");
+        assert(solve({"dac"}, "svr", "svr", small + "\nout: svr") == 0);
+        assert(solve({}, "aaa", "ccc", "aaa: bbb ccc\nbbb: ccc\nccc: aaa") ==
+               2);
+    }
+
+    {
+        // A server with room for two tables answers a stream of queries
+        const auto input = readFile(day_path("day11", "in.txt"));
+        const auto graph = Graph::parse(input);
+        PathServer<> server(graph, 2);
+
+        std::istringstream queries(
+            "you out\n"
+            "svr out dac fft\n"
+            "\n"
+            "svr out fft dac fft\n"
+            "you out\n"
+            "svr nope\n"
+            "svr\n");
+        std::ostringstream answers;
+        server.serve(queries, answers);
+        assert(answers.str() ==
+               "724\n473930047491888\n473930047491888\n724\n0\n"
+               "expected: <start> <end> [required ..]\n");
+
+        // Targets on a cycle are answered on a graph cut at the target
+        const auto looped =
+            readFile(day_path("day11", "in_small_2.txt")) + "\nout: svr";
+        const auto looped_graph = Graph::parse(looped);
+        PathServer<> cut(looped_graph, 1);
+
+        std::istringstream more(
+            "svr out dac fft\n"
+            "svr ccc\n"
+            "svr out dac fft\n"
+            "svr out\n"
+            "aaa svr\n"
+            "ggg hhh\n"
+            "svr svr dac\n");
+        std::ostringstream cut_answers;
+        cut.serve(more, cut_answers);
+        assert(cut_answers.str() == "2\n2\n2\n8\n4\ninfinite\n0\n");
+    }
+
+    {
+        // Loops are told per segment: one on the way, one elsewhere, and
+        // one on the way past a stop that is never reached
+        const auto graph =
+            Graph::parse("a: b\nb: c d\nc: b\nd: e\nx: y\ny: x");
+        PathServer<> server(graph, 4);
+
+        std::istringstream queries("a e\nd e\na e x\nd e b\nb c\na d b\n");
+        std::ostringstream answers;
+        server.serve(queries, answers);
+        assert(answers.str() == "infinite\n1\n0\n0\n1\ninfinite\n");
+    }
+
     cerr << "All tests passed\n";
 
     return 0;
@@ -136,12 +1112,21 @@ int main(int argc, char** argv) {
     using namespace std;
 
     if (argc < 3) {
-        cerr << "Usage: ./dayXX <part(1|2)> <input_file>\n";
+        cerr << "Usage: ./dayXX <part(1|2)|serve> <input_file>\n";
 
         return 1;
     }
 
     const auto input = readFile(day_path("day11", argv[2]));
+    if (argv[1] == "serve"sv) {
+        // Load the graph once and answer queries from stdin
+        const auto graph = Graph::parse(input);
+        PathServer<> server(graph, 64);
+        server.serve(cin, cout);
+
+        return 0;
+    }
+
     switch (stoi(argv[1])) {
         case 1:
             cout << solve_1(input) << endl;